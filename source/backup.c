@@ -0,0 +1,209 @@
+#include <nds.h>
+#include <fat.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include "confedit.h"
+#include "fileio.h"
+#include "backup.h"
+
+#define STAMP_LEN       18      // YYYYMMDD-HHMMSS-NN
+#define SECOND_LEN      15      // YYYYMMDD-HHMMSS
+#define BACKUP_EXT      ".bak"
+
+// Aligned so libfat can move whole sectors without going through its cache
+static u8 block[BACKUP_BLOCK_SIZE] __attribute__((aligned(32)));
+
+// Backup folder of path, and the file name inside path
+static const char *split_path(const char *path, char *dir, int size) {
+    const char *slash = strrchr(path, '/');
+    int dir_len = slash ? slash - path : 0;
+    snprintf(dir, size, "%.*s/" BACKUP_DIR_NAME, dir_len, path);
+    return slash ? slash + 1 : path;
+}
+
+// Stamp of a backup file, or NULL if file is not a backup of name.
+// A NULL name matches the backups of every file.
+static const char *backup_stamp(const char *file, const char *name) {
+    int len = strlen(file);
+    if (len < STAMP_LEN + 6 || strcasecmp(file + len - 4, BACKUP_EXT) != 0) return NULL;
+
+    const char *stamp = file + len - STAMP_LEN - 4;
+    if (stamp[-1] != '.') return NULL;
+    if (name && ((int)strlen(name) != stamp - 1 - file || strncasecmp(file, name, stamp - 1 - file) != 0))
+        return NULL;
+    return stamp;
+}
+
+// Count the backups of name in dir, with the names of the oldest and newest
+static int scan_backups(const char *dir, const char *name, char *oldest, char *newest) {
+    DIR *pdir = opendir(dir);
+    if (!pdir) return 0;
+
+    int count = 0;
+    const char *oldest_stamp = NULL;
+    const char *newest_stamp = NULL;
+    struct dirent *pent;
+    while ((pent = readdir(pdir)) != NULL) {
+        const char *stamp = backup_stamp(pent->d_name, name);
+        if (!stamp) continue;
+
+        if (count == 0 || strncmp(stamp, oldest_stamp, STAMP_LEN) < 0) {
+            strncpy(oldest, pent->d_name, MAX_PATH_LEN - 1);
+            oldest[MAX_PATH_LEN - 1] = '\0';
+            oldest_stamp = backup_stamp(oldest, NULL);
+        }
+        if (count == 0 || strncmp(stamp, newest_stamp, STAMP_LEN) > 0) {
+            strncpy(newest, pent->d_name, MAX_PATH_LEN - 1);
+            newest[MAX_PATH_LEN - 1] = '\0';
+            newest_stamp = backup_stamp(newest, NULL);
+        }
+        count++;
+    }
+    closedir(pdir);
+    return count;
+}
+
+// Remove the oldest backups over the per-file and per-folder limits
+static void rotate(const char *dir, const char *name) {
+    char oldest[MAX_PATH_LEN], newest[MAX_PATH_LEN], path[MAX_PATH_LEN];
+
+    const char *filter[2] = { name, NULL };
+    const int limit[2] = { BACKUP_GENERATIONS, BACKUP_DIR_CAP };
+    for (int i = 0; i < 2; i++) {
+        while (scan_backups(dir, filter[i], oldest, newest) > limit[i]) {
+            snprintf(path, sizeof(path), "%s/%s", dir, oldest);
+            if (remove(path) != 0) break;
+        }
+    }
+}
+
+// Path for a new backup of path, newer than the existing ones even if the
+// clock went back. Creates the backup folder. False if path does not exist.
+static bool new_backup_path(const char *path, char *out, int size, char *dir, int dir_size) {
+    struct stat st;
+    if (stat(path, &st) != 0 || S_ISDIR(st.st_mode)) return false;
+
+    const char *name = split_path(path, dir, dir_size);
+    if (mkdir(dir, 0777) == 0) FAT_setAttr(dir, FAT_getAttr(dir) | ATTR_HIDDEN);
+
+    char stamp[STAMP_LEN + 1] = "00000000-000000-00";
+    time_t now = time(NULL);
+    struct tm *tm = localtime(&now);
+    if (tm) strftime(stamp, SECOND_LEN + 1, "%Y%m%d-%H%M%S", tm);
+    int seq = 0;
+
+    char oldest[MAX_PATH_LEN], newest[MAX_PATH_LEN];
+    if (scan_backups(dir, name, oldest, newest) > 0) {
+        const char *last = backup_stamp(newest, NULL);
+        if (strncmp(last, stamp, SECOND_LEN) >= 0) {
+            memcpy(stamp, last, SECOND_LEN);
+            seq = atoi(last + SECOND_LEN + 1) + 1;
+            if (seq > 99) return false;
+        }
+    }
+    snprintf(stamp + SECOND_LEN, sizeof(stamp) - SECOND_LEN, "-%02d", seq);
+
+    snprintf(out, size, "%s/%s.%s" BACKUP_EXT, dir, name, stamp);
+    return true;
+}
+
+// Copy src to dst in large blocks
+static bool copy_file(const char *src, const char *dst) {
+    int in = open(src, O_RDONLY);
+    if (in < 0) return false;
+    int out = open(dst, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (out < 0) {
+        close(in);
+        return false;
+    }
+
+    bool ok = true;
+    int n;
+    while ((n = read(in, block, sizeof(block))) > 0) {
+        if (write(out, block, n) != n) {
+            ok = false;
+            break;
+        }
+    }
+    if (n < 0) ok = false;
+
+    close(in);
+    if (close(out) != 0) ok = false;
+    if (!ok) remove(dst);
+    return ok;
+}
+
+bool backup_move(const char *path) {
+    char dir[MAX_PATH_LEN], backup[MAX_PATH_LEN];
+    if (!new_backup_path(path, backup, sizeof(backup), dir, sizeof(dir))) return false;
+
+    // Both are on the same card, so the rename only moves the directory entry.
+    // If it fails the file is copied and stays in place.
+    if (rename(path, backup) != 0 && !copy_file(path, backup)) return false;
+
+    rotate(dir, split_path(path, dir, sizeof(dir)));
+    return true;
+}
+
+static int compare_newest_first(const void *a, const void *b) {
+    const Backup *x = a;
+    const Backup *y = b;
+    return strncmp(backup_stamp(y->name, NULL), backup_stamp(x->name, NULL), STAMP_LEN);
+}
+
+int backup_list(const char *path, Backup *out, int max) {
+    char dir[MAX_PATH_LEN];
+    const char *name = split_path(path, dir, sizeof(dir));
+
+    DIR *pdir = opendir(dir);
+    if (!pdir) return 0;
+
+    int count = 0;
+    struct dirent *pent;
+    while ((pent = readdir(pdir)) != NULL && count < max) {
+        if (!backup_stamp(pent->d_name, name)) continue;
+        strncpy(out[count].name, pent->d_name, sizeof(out[count].name) - 1);
+        out[count].name[sizeof(out[count].name) - 1] = '\0';
+        count++;
+    }
+    closedir(pdir);
+
+    qsort(out, count, sizeof(Backup), compare_newest_first);
+
+    for (int i = 0; i < count; i++) {
+        char full[MAX_PATH_LEN];
+        struct stat st;
+        snprintf(full, sizeof(full), "%s/%s", dir, out[i].name);
+        out[i].size = (stat(full, &st) == 0) ? st.st_size : 0;
+    }
+    return count;
+}
+
+bool backup_restore(const char *path, const Backup *backup) {
+    char dir[MAX_PATH_LEN], src[MAX_PATH_LEN], tmp_path[MAX_PATH_LEN];
+    split_path(path, dir, sizeof(dir));
+    snprintf(src, sizeof(src), "%s/%s", dir, backup->name);
+
+    // The backup is copied before the current version is moved in with the
+    // others, which may rotate it out
+    temp_path_for(path, tmp_path, sizeof(tmp_path));
+    if (!copy_file(src, tmp_path)) return false;
+
+    backup_move(path);
+    if (!commit_temp_file(tmp_path, path)) {
+        remove(tmp_path);
+        return false;
+    }
+    return true;
+}
+
+void backup_label(const Backup *backup, char *out, int size) {
+    const char *s = backup_stamp(backup->name, NULL);
+    snprintf(out, size, "%.4s-%.2s-%.2s %.2s:%.2s:%.2s", s, s + 4, s + 6, s + 9, s + 11, s + 13);
+}
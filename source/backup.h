@@ -0,0 +1,35 @@
+#ifndef BACKUP_H
+#define BACKUP_H
+
+#include <nds.h>
+#include "confedit.h"
+
+// Rotating backups. Before a file is rewritten, its previous version is kept
+// in a hidden folder next to it as <name>.<YYYYMMDD-HHMMSS-NN>.bak, so the
+// names sort from the oldest to the newest. Only BACKUP_GENERATIONS versions
+// of each file and BACKUP_DIR_CAP backups per folder are kept.
+
+#define BACKUP_DIR_NAME     ".confedit"   // Hidden folder created next to the file
+#define BACKUP_GENERATIONS  5             // Versions kept per file
+#define BACKUP_DIR_CAP      32            // Backups kept per folder, all files together
+#define BACKUP_BLOCK_SIZE   (32 * 1024)   // Bytes copied at once
+
+typedef struct {
+    char name[MAX_PATH_LEN];      // File name in the backup folder
+    u32 size;
+} Backup;
+
+// Move path into the backups before it is replaced by a new file.
+// A rename, so much cheaper than a copy.
+bool backup_move(const char *path);
+
+// Backups of path, newest first. Returns the count, at most max.
+int backup_list(const char *path, Backup *out, int max);
+
+// Replace path with one of its backups. The current version is backed up first.
+bool backup_restore(const char *path, const Backup *backup);
+
+// "YYYY-MM-DD HH:MM:SS" of a backup
+void backup_label(const Backup *backup, char *out, int size);
+
+#endif // BACKUP_H
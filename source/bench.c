@@ -0,0 +1,141 @@
+#include <nds.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "confedit.h"
+#include "hot.h"
+#include "dense.h"
+#include "format.h"
+#include "fold.h"
+#include "ui.h"
+#include "profile.h"
+#include "journal.h"
+#include "bench.h"
+
+#ifdef CONFEDIT_BENCH
+
+#define TYPING_RUNS     20000   // Characters typed, then deleted again, in a long line
+#define MOVE_RUNS       50      // Lines inserted, then removed, at the top of a full buffer
+#define FOLD_RUNS       20      // Structure of a full JSON buffer rebuilt
+#define RENDER_FRAMES   200     // Dense screens drawn, nearly every cell changing
+#define JOURNAL_RUNS    20      // Journal batches written to the card
+#define JOURNAL_BENCH   CONFEDIT_DIR "/bench.bin"
+
+static char lines[MAX_LINES][MAX_LINE_LENGTH] ALIGN(4);
+
+// A full JSON buffer, objects of eight lines
+static void fill_lines(void) {
+    for (int i = 0; i < MAX_LINES; i++) {
+        if (i % 8 == 0) snprintf(lines[i], MAX_LINE_LENGTH, "\"group_%d\": {", i / 8);
+        else if (i % 8 == 7) snprintf(lines[i], MAX_LINE_LENGTH, "},");
+        else snprintf(lines[i], MAX_LINE_LENGTH, "    \"key_%04d\": \"value number %d\",", i, i * 7);
+    }
+}
+
+static u32 bench_typing(void) {
+    char *line = lines[0];
+    memset(line, 'a', 120);
+    line[120] = '\0';
+
+    cpuStartTiming(0);
+    for (int i = 0; i < TYPING_RUNS; i++) {
+        text_insert(line, 120, 60, "x", 1);
+        text_delete(line, 121, 60, 61);
+    }
+    return timerTicks2usec(cpuEndTiming());
+}
+
+static u32 bench_lines(void) {
+    cpuStartTiming(0);
+    for (int i = 0; i < MOVE_RUNS; i++) {
+        lines_move(lines, 1, 0, MAX_LINES - 1);
+        lines_move(lines, 0, 1, MAX_LINES - 1);
+    }
+    return timerTicks2usec(cpuEndTiming());
+}
+
+static u32 bench_folds(void) {
+    cpuStartTiming(0);
+    for (int i = 0; i < FOLD_RUNS; i++) {
+        fold_reset(OUTLINE_BRACKETS, lines, MAX_LINES);
+        fold_visible_rows();
+    }
+    return timerTicks2usec(cpuEndTiming());
+}
+
+// dense_flush() times itself with the same timers, so the printing and the
+// flushing are timed apart
+static u32 bench_render(void) {
+    u32 usec = 0;
+    dense_attach(true);
+    for (int f = 0; f < RENDER_FRAMES; f++) {
+        cpuStartTiming(0);
+        dense_clear();
+        for (int r = 0; r < DENSE_ROWS; r++) dense_print(r, 0, lines[f % 2 + r], DENSE_NORMAL);
+        usec += timerTicks2usec(cpuEndTiming());
+        usec += dense_flush();
+    }
+    dense_detach();
+    return usec;
+}
+
+// A typing batch written the way journal.c does, the write and the sync to
+// the card timed apart. Average microseconds per batch of each in out.
+static void bench_journal(u32 out[2]) {
+    out[0] = out[1] = 0;
+    mkdir("/_nds", 0777);
+    mkdir(CONFEDIT_DIR, 0777);
+    FILE *file = fopen(JOURNAL_BENCH, "wb");
+    if (!file) return;
+
+    for (int i = 0; i < JOURNAL_RUNS; i++) {
+        cpuStartTiming(0);
+        fwrite(lines[i], 1, JOURNAL_BATCH_SIZE / 4, file);
+        fflush(file);
+        out[0] += timerTicks2usec(cpuEndTiming());
+
+        cpuStartTiming(0);
+        fsync(fileno(file));
+        out[1] += timerTicks2usec(cpuEndTiming());
+    }
+    fclose(file);
+    remove(JOURNAL_BENCH);
+    out[0] /= JOURNAL_RUNS;
+    out[1] /= JOURNAL_RUNS;
+}
+
+void bench_run(u32 (*sort_listing)(void)) {
+    fill_lines();
+    u32 typing = bench_typing();
+    u32 moves = bench_lines();
+    u32 folds = bench_folds();
+    u32 render = bench_render();
+    u32 sort = sort_listing();
+    u32 journal[2];
+    bench_journal(journal);
+
+    char message[320];
+    snprintf(message, sizeof(message),
+             "Benchmark, %s build\n"
+             "%s profile, ARM9 at %d MHz\n\n"
+             "Typing   %7lu us\n"
+             "Lines    %7lu us\n"
+             "Folds    %7lu us\n"
+             "Render   %7lu us\n"
+             "Sort     %7lu us\n"
+             "Journal  %7lu us write\n"
+             "         %7lu us sync",
+#ifdef CONFEDIT_NO_TCM
+             "main RAM",
+#else
+             "TCM",
+#endif
+             profile_get()->name, profile_cpu_mhz(),
+             (unsigned long)typing, (unsigned long)moves, (unsigned long)folds,
+             (unsigned long)render, (unsigned long)sort,
+             (unsigned long)journal[0], (unsigned long)journal[1]);
+    ui_message(message);
+}
+
+#endif // CONFEDIT_BENCH
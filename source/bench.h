@@ -0,0 +1,13 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <nds.h>
+
+// Timings of the kernels placed in TCM (hot.h), shown at startup in builds
+// made with BENCH=1. Build once more with NO_TCM=1 and compare the numbers.
+// sort_listing sorts a synthetic directory listing and returns the time
+// taken in microseconds, the listing being private to the browser. The cost
+// of writing a journal batch and of syncing it to the card is shown too.
+void bench_run(u32 (*sort_listing)(void));
+
+#endif // BENCH_H
@@ -0,0 +1,170 @@
+#include <nds.h>
+#include <stdlib.h>
+#include <string.h>
+#include "confedit.h"
+#include "buffer.h"
+
+static Buffer buffers[BUFFER_MAX];
+static int active = -1;
+static u32 use_count;
+
+static char *pool;
+static u32 pool_size;
+static u32 pool_end;        // Packed texts are all below pool_end
+
+bool buffer_init(u32 size) {
+    pool = malloc(size);
+    pool_size = pool ? size : 0;
+    return pool != NULL;
+}
+
+int buffer_find(const char *path) {
+    for (int i = 0; i < BUFFER_MAX; i++) {
+        if (buffers[i].open && strcmp(buffers[i].path, path) == 0) return i;
+    }
+    return -1;
+}
+
+bool buffer_dirty(const Buffer *buffer) {
+    return buffer->info.dirty_line < buffer->total_lines;
+}
+
+Buffer *buffer_get(int index) {
+    return &buffers[index];
+}
+
+// Least recently used inactive clean buffer, with its text in the pool if
+// loaded is set. -1 if there is none.
+static int least_recent_clean(bool loaded) {
+    int found = -1;
+    for (int i = 0; i < BUFFER_MAX; i++) {
+        Buffer *b = &buffers[i];
+        if (!b->open || i == active || buffer_dirty(b) || (loaded && !b->loaded)) continue;
+        if (found < 0 || b->used < buffers[found].used) found = i;
+    }
+    return found;
+}
+
+int buffer_open(const char *path) {
+    // The journal left for path belongs to its slot, and a slot holding
+    // the journal of another file is not reused
+    int index = journal_slot_of(path);
+    if (index >= 0 && buffers[index].open) index = -1;
+
+    for (int i = 0; i < BUFFER_MAX && index < 0; i++) {
+        if (!buffers[i].open && !journal_exists(i)) index = i;
+    }
+    if (index < 0) index = least_recent_clean(false);
+    if (index < 0) return -1;
+
+    buffer_close(index);
+    Buffer *b = &buffers[index];
+    b->open = true;
+    strncpy(b->path, path, sizeof(b->path) - 1);
+    b->path[sizeof(b->path) - 1] = '\0';
+    b->cursor_x = b->cursor_y = b->scroll = 0;
+    b->total_lines = 0;
+    b->used = ++use_count;
+    return index;
+}
+
+static void free_text(Buffer *b) {
+    b->loaded = false;
+    b->size = 0;
+}
+
+bool buffer_activate(int index, char lines[][MAX_LINE_LENGTH]) {
+    Buffer *b = &buffers[index];
+    active = index;
+    b->used = ++use_count;
+    if (!b->loaded) return false;
+
+    const char *p = pool + b->offset;
+    for (int i = 0; i < b->total_lines; i++) {
+        int len = strlen(p);
+        memcpy(lines[i], p, len + 1);
+        p += len + 1;
+    }
+    free_text(b);
+    return true;
+}
+
+// Move the packed texts down over the freed space, keeping their order
+static void compact(void) {
+    u32 end = 0;
+    while (1) {
+        int next = -1;
+        for (int i = 0; i < BUFFER_MAX; i++) {
+            Buffer *b = &buffers[i];
+            if (b->open && b->loaded && b->offset >= end && (next < 0 || b->offset < buffers[next].offset))
+                next = i;
+        }
+        if (next < 0) break;
+
+        Buffer *b = &buffers[next];
+        if (b->offset != end) memmove(pool + end, pool + b->offset, b->size);
+        b->offset = end;
+        end += b->size;
+    }
+    pool_end = end;
+}
+
+bool buffer_store(char lines[][MAX_LINE_LENGTH]) {
+    if (active < 0) return true;
+    Buffer *b = &buffers[active];
+
+    u32 size = 0;
+    for (int i = 0; i < b->total_lines; i++) size += strlen(lines[i]) + 1;
+
+    compact();
+    if (pool_end + size > pool_size) {
+        // Check that dropping clean buffers is enough before dropping any
+        u32 freeable = 0;
+        for (int i = 0; i < BUFFER_MAX; i++) {
+            Buffer *o = &buffers[i];
+            if (o->open && o->loaded && i != active && !buffer_dirty(o)) freeable += o->size;
+        }
+        if (pool_end - freeable + size > pool_size) return false;
+
+        int victim;
+        while (pool_end + size > pool_size && (victim = least_recent_clean(true)) >= 0) {
+            free_text(&buffers[victim]);
+            compact();
+        }
+    }
+
+    char *p = pool + pool_end;
+    for (int i = 0; i < b->total_lines; i++) {
+        int len = strlen(lines[i]);
+        memcpy(p, lines[i], len + 1);
+        p += len + 1;
+    }
+    b->offset = pool_end;
+    b->size = size;
+    b->loaded = true;
+    pool_end += size;
+    active = -1;
+    return true;
+}
+
+void buffer_close(int index) {
+    Buffer *b = &buffers[index];
+    free_text(b);
+    b->open = false;
+    if (index == active) active = -1;
+}
+
+int buffer_drop_clean(void) {
+    int changed = 0;
+    for (int i = 0; i < BUFFER_MAX; i++) {
+        Buffer *b = &buffers[i];
+        if (!b->open || i == active) continue;
+        if (!buffer_dirty(b)) {
+            free_text(b);
+        } else if (text_file_changed(b->path, &b->info)) {
+            b->info.dirty_line = 0;
+            changed++;
+        }
+    }
+    return changed;
+}
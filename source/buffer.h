@@ -0,0 +1,62 @@
+#ifndef BUFFER_H
+#define BUFFER_H
+
+#include <nds.h>
+#include "confedit.h"
+#include "textfile.h"
+#include "journal.h"
+
+// Open files. The active one is edited in the editor's line array, the
+// others are packed into a shared pool (each line followed by a NUL) with
+// their cursor, scroll and TextFileInfo, so switching back is a copy in RAM.
+// The pool is sized by the memory profile (profile.h) and allocated once by
+// buffer_init(). When the pool is full, the text of the least recently used clean buffers
+// is dropped and read again from the card when they are next activated.
+// Buffers with unsaved changes are never dropped.
+
+#define BUFFER_MAX        JOURNAL_SLOTS     // Files open at once, each with its journal
+
+typedef struct {
+    bool open;
+    bool loaded;                  // Text is in the pool, else it has to be read from the card
+    char path[MAX_PATH_LEN];
+    u32 offset, size;             // Packed text in the pool
+    u32 used;                     // Activation count, for dropping the least recently used
+    int total_lines;
+    int cursor_x, cursor_y, scroll;
+    TextFileInfo info;
+} Buffer;
+
+// Allocate the pool shared by the packed buffers, false if out of memory
+bool buffer_init(u32 pool_size);
+
+// Index of the open buffer of path, or -1
+int buffer_find(const char *path);
+
+// Open a buffer for path in a free slot, closing the least recently used
+// clean buffer if all are taken. Returns -1 if every buffer has unsaved
+// changes. The text is not loaded, buffer_activate() returns false for it.
+int buffer_open(const char *path);
+
+// Make index the active buffer. Its packed text is unpacked into lines and
+// its pool space freed. False if the text was dropped or never loaded.
+bool buffer_activate(int index, char lines[][MAX_LINE_LENGTH]);
+
+// Pack the active buffer into the pool, it is no longer active afterwards.
+// False, with nothing changed, if there is no room even once every clean
+// buffer was dropped.
+bool buffer_store(char lines[][MAX_LINE_LENGTH]);
+
+// Forget a buffer and its text
+void buffer_close(int index);
+
+// After files were changed on the card behind the editor's back: drop the
+// text of every inactive clean buffer, and make inactive buffers with
+// unsaved changes whose file changed rewrite it whole when saved. Returns
+// how many of those there are.
+int buffer_drop_clean(void);
+
+Buffer *buffer_get(int index);
+bool buffer_dirty(const Buffer *buffer);
+
+#endif // BUFFER_H
@@ -0,0 +1,100 @@
+#include <nds.h>
+#include <stdlib.h>
+#include <string.h>
+#include "confedit.h"
+#include "clip.h"
+
+// Referenced range, valid while referenced is set
+static bool referenced;
+static int ref_y0, ref_x0, ref_y1, ref_x1;
+
+// Detached content: segment i is pool[offset[i]..offset[i + 1])
+static char *pool;
+static u32 pool_size;
+static u32 offset[MAX_LINES + 1];
+static int segment_count;
+
+bool clip_init(u32 size) {
+    pool = malloc(size);
+    pool_size = pool ? size : 0;
+    return pool != NULL;
+}
+
+void clip_copy(int y0, int x0, int y1, int x1) {
+    referenced = true;
+    ref_y0 = y0;
+    ref_x0 = x0;
+    ref_y1 = y1;
+    ref_x1 = x1;
+    segment_count = y1 - y0 + 1;
+}
+
+int clip_segments(void) {
+    return segment_count;
+}
+
+const char *clip_segment(char lines[][MAX_LINE_LENGTH], int index, int *len) {
+    if (!referenced) {
+        *len = offset[index + 1] - offset[index];
+        return pool + offset[index];
+    }
+
+    const char *line = lines[ref_y0 + index];
+    int start = (index == 0) ? ref_x0 : 0;
+    int end = (index == segment_count - 1) ? ref_x1 : (int)strlen(line);
+    *len = end - start;
+    return line + start;
+}
+
+void clip_detach(char lines[][MAX_LINE_LENGTH]) {
+    if (!referenced) return;
+
+    // Every segment is measured first, so a clipboard too large for the
+    // pool is dropped before anything is copied
+    u32 total = 0;
+    for (int i = 0; i < segment_count; i++) {
+        int len;
+        clip_segment(lines, i, &len);
+        offset[i] = total;
+        total += len;
+    }
+    offset[segment_count] = total;
+
+    if (total > pool_size) {
+        referenced = false;
+        segment_count = 0;
+        return;
+    }
+
+    for (int i = 0; i < segment_count; i++) {
+        int len;
+        const char *text = clip_segment(lines, i, &len);
+        memcpy(pool + offset[i], text, len);
+    }
+    referenced = false;
+}
+
+bool clip_before_edit(char lines[][MAX_LINE_LENGTH], int first, int last) {
+    if (!referenced || last < ref_y0 || first > ref_y1) return true;
+    clip_detach(lines);
+    return segment_count > 0;
+}
+
+void clip_before_insert(char lines[][MAX_LINE_LENGTH], int index, int count) {
+    if (!referenced) return;
+    if (index > ref_y0 && index <= ref_y1) {
+        // Lines inserted inside the range would end up in the clipboard
+        clip_detach(lines);
+    } else if (index <= ref_y0) {
+        ref_y0 += count;
+        ref_y1 += count;
+    }
+}
+
+void clip_before_remove(char lines[][MAX_LINE_LENGTH], int index, int count) {
+    if (!clip_before_edit(lines, index, index + count - 1) || !referenced) return;
+    if (index < ref_y0) {
+        ref_y0 -= count;
+        ref_y1 -= count;
+    }
+}
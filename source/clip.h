@@ -0,0 +1,36 @@
+#ifndef CLIP_H
+#define CLIP_H
+
+#include <nds.h>
+#include "confedit.h"
+
+// Clipboard shared by every file opened in the editor.
+// Copying only records the range in the buffer. The text is copied into the
+// clipboard's own pool when that range is about to be edited, or when the
+// file is closed, so copying and pasting a large block costs no extra copy.
+
+// Allocate the pool holding the text once detached from the buffer, its
+// size comes from the memory profile (profile.h). False if out of memory.
+bool clip_init(u32 pool_size);
+
+// Reference lines[y0] from x0 to lines[y1] up to x1 (excluded)
+void clip_copy(int y0, int x0, int y1, int x1);
+
+// The clipboard content is n segments, joined by line breaks. Segments
+// pointing into the buffer are not NUL terminated, use len.
+int clip_segments(void);
+const char *clip_segment(char lines[][MAX_LINE_LENGTH], int index, int *len);
+
+// Call before changing the text of lines first..last, copies the clipboard
+// out of the buffer if it references them. False if it did not fit and the
+// clipboard was emptied.
+bool clip_before_edit(char lines[][MAX_LINE_LENGTH], int first, int last);
+
+// Call before inserting or removing lines, so references follow their lines
+void clip_before_insert(char lines[][MAX_LINE_LENGTH], int index, int count);
+void clip_before_remove(char lines[][MAX_LINE_LENGTH], int index, int count);
+
+// Call before the buffer is closed or reloaded
+void clip_detach(char lines[][MAX_LINE_LENGTH]);
+
+#endif // CLIP_H
@@ -0,0 +1,316 @@
+#include <nds.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include "confedit.h"
+#include "format.h"
+#include "complete.h"
+
+// Children are a linked list through first child and next sibling, so a
+// node is 8 bytes whatever the character set of the keys
+typedef struct {
+    u16 child;          // First child, 0 if none
+    u16 sibling;        // Next child of the parent, 0 if none
+    u16 words;          // Keys going through this node
+    u8 ends;            // Keys ending at this node
+    char c;
+} TrieNode;
+
+static TrieNode nodes[COMPLETE_MAX_NODES];  // nodes[0] is the root
+static int node_count;
+static u16 free_nodes;                      // Released subtrees, linked through sibling, 0 if none
+static const Format *format;                // Format of the lines given
+
+// Keys of the dictionaries read from the card, each followed by a NUL, so
+// activating a buffer again reads nothing
+typedef struct {
+    char ext[FORMAT_MAX_EXT + 1];   // Lowercase extension
+    int offset, size;               // Keys in dict_pool, size -1 if there is no dictionary
+} Dictionary;
+
+static Dictionary dicts[COMPLETE_DICT_FILES];
+static int dict_count;
+static char dict_pool[COMPLETE_DICT_POOL];
+static int dict_pool_used;
+
+static bool key_char(char c) {
+    return isalnum((unsigned char)c) || c == '_' || c == '-' || c == '.';
+}
+
+// Start of the key on a line: after indentation, an XML '<' or '</' and a
+// JSON quote. Returns -1 for comments and sections, which hold no key.
+static int key_start(const char *line) {
+    int i = 0;
+    while (line[i] == ' ' || line[i] == '\t') i++;
+    if (line[i] == '<') {
+        i++;
+        if (line[i] == '/') i++;
+    } else if (line[i] == '"') {
+        i++;
+    } else if (line[i] && strchr(format->comments, line[i])) {
+        return -1;
+    } else if (line[i] == '[' && format->outline == OUTLINE_SECTIONS) {
+        return -1;
+    }
+    return i;
+}
+
+// Key of a line with its length, 0 if the line has none. Keys are followed
+// by a separator of the format ('=', ':') or are an XML tag name.
+static int line_key(const char *line, const char **key) {
+    int start = key_start(line);
+    if (start < 0) return 0;
+
+    int end = start;
+    while (key_char(line[end])) end++;
+    if (end == start || end - start > COMPLETE_MAX_KEY) return 0;
+
+    bool xml = (start > 0 && (line[start - 1] == '<' || line[start - 1] == '/'));
+    if (!xml) {
+        int i = end;
+        if (line[i] == '"') i++;
+        while (line[i] == ' ' || line[i] == '\t') i++;
+        if (line[i] == '\0' || !strchr(format->separators, line[i])) return 0;
+    }
+
+    *key = line + start;
+    return end - start;
+}
+
+static int find_child(int node, char c) {
+    for (int n = nodes[node].child; n != 0; n = nodes[n].sibling) {
+        if (nodes[n].c == c) return n;
+    }
+    return 0;
+}
+
+// Unlink node from the children of parent and give it back with its
+// subtree, which holds no key either
+static void release_node(int parent, int node) {
+    u16 *link = &nodes[parent].child;
+    while (*link != node) link = &nodes[*link].sibling;
+    *link = nodes[node].sibling;
+
+    nodes[node].sibling = free_nodes;
+    free_nodes = node;
+}
+
+// A node off the free list, or a never used one. The children of a
+// released node go back on the list when it is taken. 0 if the pool is full.
+static int new_node(void) {
+    if (free_nodes == 0) return (node_count < COMPLETE_MAX_NODES) ? node_count++ : 0;
+
+    int node = free_nodes;
+    free_nodes = nodes[node].sibling;
+    int child = nodes[node].child;
+    if (child != 0) {
+        int last = child;
+        while (nodes[last].sibling != 0) last = nodes[last].sibling;
+        nodes[last].sibling = free_nodes;
+        free_nodes = child;
+    }
+    return node;
+}
+
+static void trie_add(const char *key, int len) {
+    int path[COMPLETE_MAX_KEY];
+    int node = 0;
+    int first_new = -1;         // Depth of the first node created
+
+    // Create the missing nodes first, so a full pool leaves the trie unchanged
+    for (int i = 0; i < len; i++) {
+        int next = find_child(node, key[i]);
+        if (next == 0) {
+            next = new_node();
+            if (next == 0) {
+                if (first_new >= 0) release_node(first_new > 0 ? path[first_new - 1] : 0, path[first_new]);
+                return;
+            }
+            if (first_new < 0) first_new = i;
+            nodes[next].c = key[i];
+            nodes[next].child = 0;
+            nodes[next].words = 0;
+            nodes[next].ends = 0;
+            nodes[next].sibling = nodes[node].child;
+            nodes[node].child = next;
+        }
+        path[i] = node = next;
+    }
+
+    if (nodes[node].ends == 255) return;
+    nodes[node].ends++;
+    for (int i = 0; i < len; i++) nodes[path[i]].words++;
+}
+
+// Nodes no key goes through any more are released, so editing keys one
+// character at a time does not use up the pool
+static void trie_remove(const char *key, int len) {
+    int path[COMPLETE_MAX_KEY];
+    int node = 0;
+
+    for (int i = 0; i < len; i++) {
+        node = find_child(node, key[i]);
+        if (node == 0) return;
+        path[i] = node;
+    }
+
+    if (nodes[node].ends == 0) return;
+    nodes[node].ends--;
+    for (int i = 0; i < len; i++) {
+        if (--nodes[path[i]].words == 0) {
+            // Its subtree goes with it, the counts below are not needed any more
+            release_node(i > 0 ? path[i - 1] : 0, path[i]);
+            return;
+        }
+    }
+}
+
+void complete_forget_dictionaries(void) {
+    dict_count = 0;
+    dict_pool_used = 0;
+}
+
+// Keep a key of the dictionary being read from start in dict_pool. When it
+// is full, the other dictionaries make room. False if this one alone does
+// not fit.
+static bool keep_key(int *start, const char *key, int len) {
+    if (dict_pool_used + len + 1 > COMPLETE_DICT_POOL && *start > 0) {
+        memmove(dict_pool, dict_pool + *start, dict_pool_used - *start);
+        dict_pool_used -= *start;
+        *start = 0;
+        dict_count = 0;
+    }
+    if (dict_pool_used + len + 1 > COMPLETE_DICT_POOL) return false;
+
+    memcpy(dict_pool + dict_pool_used, key, len);
+    dict_pool[dict_pool_used + len] = '\0';
+    dict_pool_used += len + 1;
+    return true;
+}
+
+static void load_dictionary(const char *filepath) {
+    const char *ext = strrchr(filepath, '.');
+    if (!ext || strchr(ext, '/')) return;
+
+    char dict_path[MAX_PATH_LEN];
+    snprintf(dict_path, sizeof(dict_path), "%s/dict/%s.txt", CONFEDIT_DIR, ext + 1);
+    for (char *p = dict_path + strlen(CONFEDIT_DIR); *p; p++) *p = tolower((unsigned char)*p);
+
+    // Extension as it is in the path, lowercase
+    const char *lower = dict_path + strlen(CONFEDIT_DIR) + strlen("/dict/");
+    int ext_len = strlen(ext + 1);
+    bool cache = ext_len <= FORMAT_MAX_EXT;
+
+    for (int i = 0; cache && i < dict_count; i++) {
+        if (strncmp(dicts[i].ext, lower, ext_len) != 0 || dicts[i].ext[ext_len] != '\0') continue;
+        for (int k = dicts[i].offset; k < dicts[i].offset + dicts[i].size; k += strlen(dict_pool + k) + 1)
+            trie_add(dict_pool + k, strlen(dict_pool + k));
+        return;
+    }
+    if (cache && dict_count == COMPLETE_DICT_FILES) complete_forget_dictionaries();
+
+    int start = dict_pool_used;
+    FILE *file = fopen(dict_path, "rb");
+    if (file) {
+        char line[MAX_LINE_LENGTH];
+        while (fgets(line, sizeof(line), file)) {
+            int len = 0;
+            while (key_char(line[len])) len++;
+            if (len == 0 || len > COMPLETE_MAX_KEY) continue;
+            trie_add(line, len);
+            if (cache) cache = keep_key(&start, line, len);
+        }
+        fclose(file);
+    }
+
+    // A dictionary larger than the pool is read again each time
+    if (!cache) {
+        dict_pool_used = start;
+        return;
+    }
+    Dictionary *dict = &dicts[dict_count++];
+    memcpy(dict->ext, lower, ext_len);
+    dict->ext[ext_len] = '\0';
+    dict->offset = start;
+    dict->size = file ? dict_pool_used - start : -1;
+}
+
+void complete_set_format(const Format *f) {
+    format = f;
+}
+
+void complete_reset(const char *filepath) {
+    memset(&nodes[0], 0, sizeof(TrieNode));
+    node_count = 1;
+    free_nodes = 0;
+    load_dictionary(filepath);
+}
+
+void complete_add_line(const char *line) {
+    const char *key;
+    int len = line_key(line, &key);
+    if (len > 0) trie_add(key, len);
+}
+
+void complete_remove_line(const char *line) {
+    const char *key;
+    int len = line_key(line, &key);
+    if (len > 0) trie_remove(key, len);
+}
+
+int complete_prefix(const char *line, int cursor_x) {
+    int start = key_start(line);
+    if (start < 0 || cursor_x <= start || key_char(line[cursor_x])) return 0;
+
+    for (int i = start; i < cursor_x; i++) {
+        if (!key_char(line[i])) return 0;
+    }
+    return (cursor_x - start <= COMPLETE_MAX_KEY) ? cursor_x - start : 0;
+}
+
+int complete_lookup(const char *prefix, int len, char out[][COMPLETE_MAX_KEY + 1], int max) {
+    int node = 0;
+    for (int i = 0; i < len; i++) {
+        node = find_child(node, prefix[i]);
+        if (node == 0 || nodes[node].words == 0) return 0;
+    }
+
+    // Depth first walk below the prefix, stopping at max keys. Only subtrees
+    // still holding keys are entered, so the walk visits about max * key
+    // length nodes whatever the size of the trie.
+    char key[COMPLETE_MAX_KEY + 1];
+    int stack[COMPLETE_MAX_KEY + 1];
+    int depth = len;
+    int found = 0;
+
+    memcpy(key, prefix, len);
+    stack[depth] = nodes[node].child;
+
+    while (depth >= len && found < max) {
+        int n = stack[depth];
+        if (n == 0) {
+            // No more children at this depth, continue with the parent's sibling
+            depth--;
+            if (depth >= len) stack[depth] = nodes[stack[depth]].sibling;
+            continue;
+        }
+        if (nodes[n].words == 0) {
+            stack[depth] = nodes[n].sibling;
+            continue;
+        }
+
+        key[depth] = nodes[n].c;
+        if (nodes[n].ends > 0) {
+            memcpy(out[found], key, depth + 1);
+            out[found][depth + 1] = '\0';
+            found++;
+        }
+        if (depth + 1 < COMPLETE_MAX_KEY && nodes[n].child != 0) {
+            depth++;
+            stack[depth] = nodes[n].child;
+        } else {
+            stack[depth] = nodes[n].sibling;
+        }
+    }
+    return found;
+}
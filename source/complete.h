@@ -0,0 +1,39 @@
+#ifndef COMPLETE_H
+#define COMPLETE_H
+
+#include <nds.h>
+#include "format.h"
+
+// Key autocompletion. Every key of the open buffer is kept in a prefix trie,
+// updated line by line as the buffer is edited, plus the keys of an optional
+// dictionary per file extension:
+//   /_nds/ConfEdit/dict/<extension>.txt, one key per line
+
+#define COMPLETE_MAX_NODES   16384   // Trie nodes, one per distinct key prefix
+#define COMPLETE_MAX_KEY     48      // Longest key kept in the trie
+#define COMPLETE_SUGGESTIONS 4       // Suggestions shown at once
+#define COMPLETE_DICT_FILES  8       // Dictionaries kept in RAM, by extension
+#define COMPLETE_DICT_POOL   (16 * 1024)  // Bytes of the keys of those dictionaries
+
+// Format the keys of the following lines are read with, set before adding any
+void complete_set_format(const Format *format);
+
+// Empty the trie, then add the dictionary matching the extension of filepath.
+// Each dictionary is read from the card once, then kept in RAM.
+void complete_reset(const char *filepath);
+
+// Dictionary files on the card may have changed, read them again when next needed
+void complete_forget_dictionaries(void);
+
+// Add or remove the key of a buffer line, lines without a key are ignored
+void complete_add_line(const char *line);
+void complete_remove_line(const char *line);
+
+// Length of the key being typed before cursor_x on line, 0 if the cursor is
+// not at the end of a key
+int complete_prefix(const char *line, int cursor_x);
+
+// Keys starting with prefix and longer than it, returns how many were found
+int complete_lookup(const char *prefix, int len, char out[][COMPLETE_MAX_KEY + 1], int max);
+
+#endif // COMPLETE_H
@@ -0,0 +1,34 @@
+#ifndef CONFEDIT_H
+#define CONFEDIT_H
+
+#include <nds.h>
+
+// Constants
+#define CONFEDIT_DIR      "/_nds/ConfEdit"  // Settings and data kept on the card
+#define SCREEN_LINES      24      // Number of visible lines on screen
+#define SCREEN_COLUMNS    32      // Number of visible columns on screen
+#define TOP_MARGIN 3      // Top margin for header
+#define MAX_VISIBLE_LINES (SCREEN_LINES - TOP_MARGIN)
+
+// Browser
+#define MAX_PATH_LEN      256     // Max length for file paths
+
+#define SKIP_LINES        20      // Number of lines to skip on left/right key press
+#define BROWSER_REPEAT_DELAY 15
+#define BROWSER_REPEAT_RATE 3
+#define META_FRAME_TICKS  (BUS_CLOCK / 250)  // Time spent on stat() per frame, ~4ms
+
+// Editor
+#define MAX_LINES         1024    // Max lines in a text file
+#define MAX_LINE_LENGTH   256     // Max length of a single line
+
+#define EDITOR_REPEAT_DELAY 20
+#define EDITOR_REPEAT_RATE 4
+
+// Shared between the browser, the editor and the tools built on them
+bool is_supported_file(const char *filename);
+// Open the editor with the cursor on start_line (0-based), or where the
+// buffer's cursor was left with start_line < 0
+void view_text_file(const char *filepath, int start_line);
+
+#endif // CONFEDIT_H
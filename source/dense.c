@@ -0,0 +1,124 @@
+#include <nds.h>
+#include <string.h>
+#include "font4x8.h"
+#include "dense.h"
+#include "hot.h"
+
+#define DENSE_MAP_BASE_MAIN   0     // Logo and console are reloaded when leaving
+#define DENSE_MAP_BASE_SUB    4     // Above the console map at base 31 (62KB)
+#define DENSE_PALETTE         240   // First of the palette entries used
+#define DENSE_STRIDE          (256 / 4)  // Bitmap row in u32
+
+static const u16 dense_colors[] = {
+    RGB15(0, 0, 0),     // Background
+    RGB15(31, 31, 31),  // Text
+    RGB15(4, 10, 24),   // Cursor background
+    RGB15(18, 18, 18),  // Dim text
+};
+
+// Glyph rows expanded to 8bpp pixels, four per u32, for each attribute
+static u32 glyph_rows[DENSE_ATTRS][FONT4X8_GLYPHS][8];
+static bool glyphs_ready;
+
+// Compared in full every frame, so both are in DTCM (6KB). The glyphs are
+// too large for it and stay in main RAM behind the data cache.
+static u16 cells[DENSE_ROWS][DENSE_COLUMNS] HOT_BSS;    // Wanted content, char | attr << 8
+static u16 shadow[DENSE_ROWS][DENSE_COLUMNS] HOT_BSS;   // Content on screen
+
+static u32 *gfx;
+static int attached = -1;   // -1 none, 1 main screen, 0 sub screen
+
+static void build_glyphs(void) {
+    static const u8 fg[DENSE_ATTRS] = { DENSE_PALETTE + 1, DENSE_PALETTE + 1, DENSE_PALETTE + 3 };
+    static const u8 bg[DENSE_ATTRS] = { DENSE_PALETTE, DENSE_PALETTE + 2, DENSE_PALETTE };
+
+    for (int a = 0; a < DENSE_ATTRS; a++) {
+        for (int g = 0; g < FONT4X8_GLYPHS; g++) {
+            for (int y = 0; y < 8; y++) {
+                u32 bits = (font4x8[g] >> (28 - 4 * y)) & 0xF;
+                u32 row = 0;
+                for (int x = 0; x < 4; x++) {
+                    u32 pixel = (bits & (8 >> x)) ? fg[a] : bg[a];
+                    row |= pixel << (8 * x);
+                }
+                glyph_rows[a][g][y] = row;
+            }
+        }
+    }
+    glyphs_ready = true;
+}
+
+void dense_attach(bool main_screen) {
+    if (attached == main_screen) return;
+    if (!glyphs_ready) build_glyphs();
+
+    u16 *palette;
+    int bg;
+    if (main_screen) {
+        videoSetMode(MODE_5_2D);
+        vramSetBankA(VRAM_A_MAIN_BG);
+        bg = bgInit(2, BgType_Bmp8, BgSize_B8_256x256, DENSE_MAP_BASE_MAIN, 0);
+        palette = BG_PALETTE;
+    } else {
+        videoSetModeSub(MODE_5_2D);
+        vramSetBankC(VRAM_C_SUB_BG);
+        bg = bgInitSub(2, BgType_Bmp8, BgSize_B8_256x256, DENSE_MAP_BASE_SUB, 0);
+        palette = BG_PALETTE_SUB;
+    }
+
+    for (int i = 0; i < 4; i++)
+        palette[DENSE_PALETTE + i] = dense_colors[i];
+
+    gfx = (u32 *)bgGetGfxPtr(bg);
+    dmaFillWords(DENSE_PALETTE * 0x01010101u, gfx, 256 * 192);
+
+    // The cleared bitmap shows spaces everywhere
+    for (int r = 0; r < DENSE_ROWS; r++)
+        for (int c = 0; c < DENSE_COLUMNS; c++)
+            shadow[r][c] = ' ';
+
+    attached = main_screen;
+}
+
+void dense_detach(void) {
+    attached = -1;
+}
+
+HOT_CODE void dense_clear(void) {
+    for (int r = 0; r < DENSE_ROWS; r++)
+        for (int c = 0; c < DENSE_COLUMNS; c++)
+            cells[r][c] = ' ';
+}
+
+HOT_CODE void dense_put(int row, int col, char c, u8 attr) {
+    if (row < 0 || row >= DENSE_ROWS || col < 0 || col >= DENSE_COLUMNS) return;
+    if ((u8)c < FONT4X8_FIRST || (u8)c >= FONT4X8_FIRST + FONT4X8_GLYPHS) c = (c == '\t') ? ' ' : '.';
+    cells[row][col] = (u8)c | (attr << 8);
+}
+
+HOT_CODE int dense_print(int row, int col, const char *text, u8 attr) {
+    int start = col;
+    while (*text && col < DENSE_COLUMNS) {
+        dense_put(row, col++, *text++, attr);
+    }
+    return col - start;
+}
+
+HOT_CODE u32 dense_flush(void) {
+    if (attached < 0) return 0;
+
+    cpuStartTiming(0);
+    for (int r = 0; r < DENSE_ROWS; r++) {
+        for (int c = 0; c < DENSE_COLUMNS; c++) {
+            u16 cell = cells[r][c];
+            if (cell == shadow[r][c]) continue;
+            shadow[r][c] = cell;
+
+            const u32 *glyph = glyph_rows[cell >> 8][(cell & 0xFF) - FONT4X8_FIRST];
+            u32 *dst = gfx + r * 8 * DENSE_STRIDE + c;
+            for (int y = 0; y < 8; y++)
+                dst[y * DENSE_STRIDE] = glyph[y];
+        }
+    }
+    return timerTicks2usec(cpuEndTiming());
+}
@@ -0,0 +1,36 @@
+#ifndef DENSE_H
+#define DENSE_H
+
+#include <nds.h>
+
+// Dense text mode: 64x24 characters drawn with a 4x8 font into an 8bpp
+// bitmap background. Text is written to a shadow grid and dense_flush()
+// only redraws the cells that changed.
+
+#define DENSE_COLUMNS   64
+#define DENSE_ROWS      24
+
+enum {
+    DENSE_NORMAL,
+    DENSE_INVERSE,      // Cursor and selected entries
+    DENSE_DIM,          // Headers and status lines
+    DENSE_ATTRS
+};
+
+// Show the dense layer on the main (top) or sub (bottom) screen.
+// Does nothing if it is already shown there.
+void dense_attach(bool main_screen);
+
+// Forget the layer, to be called when a console takes the screen back
+void dense_detach(void);
+
+void dense_clear(void);
+void dense_put(int row, int col, char c, u8 attr);
+
+// Print text from (row, col) up to the end of the row, returns the columns used
+int dense_print(int row, int col, const char *text, u8 attr);
+
+// Draw the cells that changed since the last flush, returns the time taken in microseconds
+u32 dense_flush(void);
+
+#endif // DENSE_H
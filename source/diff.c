@@ -0,0 +1,274 @@
+#include <nds.h>
+#include <stdio.h>
+#include <string.h>
+#include "confedit.h"
+#include "ui.h"
+#include "textfile.h"
+#include "diff.h"
+
+// Line diff between the file on disk (old) and the editor buffer (new).
+// Lines are compared by hash with Myers' linear space algorithm, all the
+// working memory is the fixed scratch below.
+
+#define DIFF_MAX_VIEW     512       // Max lines in the hunk view
+#define DIFF_CONTEXT      1         // Unchanged lines shown around a hunk
+#define DIFF_MAX_OLD      (MAX_LINES * 2)
+#define DIFF_V_SIZE       (DIFF_MAX_OLD + MAX_LINES + 2)
+
+enum { VIEW_HEADER, VIEW_CONTEXT, VIEW_REMOVED, VIEW_ADDED };
+
+typedef struct {
+    u8 kind;
+    u16 old_line;
+    u16 new_line;
+} ViewLine;
+
+static u32 old_hash[DIFF_MAX_OLD];
+static u32 new_hash[MAX_LINES];
+static u8 old_keep[DIFF_MAX_OLD];
+static u8 new_keep[MAX_LINES];
+static int old_count, new_count;
+
+static int v_forward[DIFF_V_SIZE * 2 + 1];
+static int v_backward[DIFF_V_SIZE * 2 + 1];
+
+static ViewLine view[DIFF_MAX_VIEW];
+static char view_old_text[DIFF_MAX_VIEW][SCREEN_COLUMNS];
+static int view_count;
+static char view_text[SCREEN_COLUMNS + 8];
+
+static char (*new_lines)[MAX_LINE_LENGTH];
+static TextReader reader;
+
+static inline u32 hash_bytes(u32 h, const u8 *p, int n) {
+    while (n--) h = (h ^ *p++) * 16777619u;
+    return h;
+}
+
+#define HASH_SEED 2166136261u
+
+// Read the file on disk, hash its lines and check if it is byte-identical
+// to what save_file() would write. Returns false if the file can't be read.
+static bool hash_disk_file(const char *filepath, const TextFileInfo *info, bool *identical) {
+    old_count = 0;
+    *identical = false;
+    if (!text_reader_open(&reader, filepath)) return false;
+
+    bool same = (reader.bom == info->bom);
+    const u8 *line;
+    int len, eol;
+
+    while ((eol = text_reader_next(&reader, &line, &len)) >= 0) {
+        if (same && (old_count >= new_count || info->line_eol[old_count] != eol ||
+                     memcmp(new_lines[old_count], line, len) != 0 || new_lines[old_count][len] != '\0'))
+            same = false;
+
+        if (old_count < DIFF_MAX_OLD) old_hash[old_count] = hash_bytes(HASH_SEED ^ eol, line, len);
+        old_count++;
+    }
+    text_reader_close(&reader);
+
+    // An empty file reads as no lines but is edited as one empty line
+    if (old_count == 0 && new_count == 1 && new_lines[0][0] == '\0' && info->line_eol[0] == EOL_NONE)
+        old_count = 1;
+
+    *identical = same && old_count == new_count;
+    if (old_count > DIFF_MAX_OLD) old_count = DIFF_MAX_OLD;
+    return true;
+}
+
+// Find the middle snake of old[a0..a1) / new[b0..b1), in forward coordinates
+static void middle_snake(int a0, int a1, int b0, int b1, int *x0, int *y0, int *x1, int *y1) {
+    int n = a1 - a0, m = b1 - b0;
+    int delta = n - m;
+    bool odd = delta & 1;
+    int max_d = (n + m + 1) / 2;
+    int *vf = v_forward + DIFF_V_SIZE;
+    int *vb = v_backward + DIFF_V_SIZE;
+
+    vf[1] = 0;
+    vb[1] = 0;
+
+    for (int d = 0; d <= max_d; d++) {
+        for (int k = -d; k <= d; k += 2) {
+            int x = (k == -d || (k != d && vf[k - 1] < vf[k + 1])) ? vf[k + 1] : vf[k - 1] + 1;
+            int y = x - k;
+            int xs = x, ys = y;
+            while (x < n && y < m && old_hash[a0 + x] == new_hash[b0 + y]) {
+                x++;
+                y++;
+            }
+            vf[k] = x;
+
+            int c = delta - k;
+            if (odd && c >= -(d - 1) && c <= d - 1 && vf[k] + vb[c] >= n) {
+                *x0 = a0 + xs; *y0 = b0 + ys;
+                *x1 = a0 + x;  *y1 = b0 + y;
+                return;
+            }
+        }
+
+        for (int k = -d; k <= d; k += 2) {
+            int x = (k == -d || (k != d && vb[k - 1] < vb[k + 1])) ? vb[k + 1] : vb[k - 1] + 1;
+            int y = x - k;
+            int xs = x, ys = y;
+            while (x < n && y < m && old_hash[a1 - x - 1] == new_hash[b1 - y - 1]) {
+                x++;
+                y++;
+            }
+            vb[k] = x;
+
+            int c = delta - k;
+            if (!odd && c >= -d && c <= d && vf[c] + vb[k] >= n) {
+                *x0 = a1 - x;  *y0 = b1 - y;
+                *x1 = a1 - xs; *y1 = b1 - ys;
+                return;
+            }
+        }
+    }
+
+    // Not reached for valid input, treat the range as fully replaced
+    *x0 = *x1 = a0;
+    *y0 = *y1 = b0;
+}
+
+// Mark the lines kept in both versions
+static void diff_range(int a0, int a1, int b0, int b1) {
+    while (a0 < a1 && b0 < b1 && old_hash[a0] == new_hash[b0]) {
+        old_keep[a0++] = new_keep[b0++] = 1;
+    }
+    while (a0 < a1 && b0 < b1 && old_hash[a1 - 1] == new_hash[b1 - 1]) {
+        old_keep[--a1] = new_keep[--b1] = 1;
+    }
+    if (a0 == a1 || b0 == b1) return;
+
+    int x0, y0, x1, y1;
+    middle_snake(a0, a1, b0, b1, &x0, &y0, &x1, &y1);
+
+    for (int x = x0, y = y0; x < x1; x++, y++)
+        old_keep[x] = new_keep[y] = 1;
+
+    // A snake touching the far corner means the search gave up, leave the
+    // range as replaced rather than recursing on the same problem
+    if ((x0 == a1 && y0 == b1) || (x1 == a0 && y1 == b0)) return;
+
+    diff_range(a0, x0, b0, y0);
+    diff_range(x1, a1, y1, b1);
+}
+
+static void add_view(u8 kind, int old_line, int new_line) {
+    if (view_count >= DIFF_MAX_VIEW) return;
+    view[view_count].kind = kind;
+    view[view_count].old_line = old_line;
+    view[view_count].new_line = new_line;
+    view_count++;
+}
+
+// Build the hunk list from the kept lines, returns the number of hunks
+static int build_view(int *added, int *removed) {
+    int i = 0, j = 0;
+    int hunks = 0;
+    view_count = 0;
+    *added = *removed = 0;
+
+    while (i < old_count || j < new_count) {
+        if (i < old_count && j < new_count && old_keep[i] && new_keep[j]) {
+            i++;
+            j++;
+            continue;
+        }
+
+        hunks++;
+        add_view(VIEW_HEADER, i, j);
+        for (int c = DIFF_CONTEXT; c > 0; c--) {
+            if (i - c >= 0 && j - c >= 0) add_view(VIEW_CONTEXT, i - c, j - c);
+        }
+        while (i < old_count && !old_keep[i]) {
+            add_view(VIEW_REMOVED, i++, j);
+            (*removed)++;
+        }
+        while (j < new_count && !new_keep[j]) {
+            add_view(VIEW_ADDED, i, j++);
+            (*added)++;
+        }
+        for (int c = 0; c < DIFF_CONTEXT && i + c < old_count && j + c < new_count; c++) {
+            if (!old_keep[i + c] || !new_keep[j + c]) break;
+            add_view(VIEW_CONTEXT, i + c, j + c);
+        }
+    }
+    return hunks;
+}
+
+// Second pass over the file to fetch the text of the removed lines
+static void load_removed_text(const char *filepath) {
+    if (!text_reader_open(&reader, filepath)) return;
+
+    int v = 0;
+    int line_index = 0;
+    const u8 *line;
+    int len;
+
+    while (v < view_count && text_reader_next(&reader, &line, &len) >= 0) {
+        while (v < view_count && (view[v].kind != VIEW_REMOVED || view[v].old_line < line_index)) v++;
+        if (v < view_count && view[v].old_line == line_index) {
+            int n = (len < SCREEN_COLUMNS - 1) ? len : SCREEN_COLUMNS - 1;
+            for (int c = 0; c < n; c++)
+                view_old_text[v][c] = (line[c] >= 32 && line[c] <= 126) ? line[c] : '.';
+            view_old_text[v][n] = '\0';
+        }
+        line_index++;
+    }
+    text_reader_close(&reader);
+}
+
+static const char *get_view_line(int index) {
+    const ViewLine *l = &view[index];
+    switch (l->kind) {
+        case VIEW_HEADER:
+            snprintf(view_text, sizeof(view_text), "@@ -%d +%d @@", l->old_line + 1, l->new_line + 1);
+            break;
+        case VIEW_CONTEXT:
+            snprintf(view_text, sizeof(view_text), " %.*s", SCREEN_COLUMNS - 1, new_lines[l->new_line]);
+            break;
+        case VIEW_REMOVED:
+            snprintf(view_text, sizeof(view_text), "-%s", view_old_text[index]);
+            break;
+        case VIEW_ADDED:
+            snprintf(view_text, sizeof(view_text), "+%.*s", SCREEN_COLUMNS - 1, new_lines[l->new_line]);
+            break;
+    }
+    return view_text;
+}
+
+int diff_preview(const char *filepath, char lines[][MAX_LINE_LENGTH], int count, const TextFileInfo *info) {
+    new_lines = lines;
+    new_count = count;
+
+    cpuStartTiming(0);
+
+    bool identical;
+    bool exists = hash_disk_file(filepath, info, &identical);
+    if (identical) {
+        cpuEndTiming();
+        return DIFF_UNCHANGED;
+    }
+
+    for (int j = 0; j < new_count; j++)
+        new_hash[j] = hash_bytes(HASH_SEED ^ info->line_eol[j], (const u8 *)lines[j], strlen(lines[j]));
+
+    memset(old_keep, 0, old_count);
+    memset(new_keep, 0, new_count);
+    diff_range(0, old_count, 0, new_count);
+
+    int added, removed;
+    int hunks = build_view(&added, &removed);
+    if (exists && removed > 0) load_removed_text(filepath);
+
+    u32 ms = timerTicks2msec(cpuEndTiming());
+
+    char title[SCREEN_COLUMNS * 3];
+    snprintf(title, sizeof(title), "%d hunks +%d -%d (%lums)\nA: save  B: back to editor",
+             hunks, added, removed, (unsigned long)ms);
+
+    return (ui_view_lines(title, get_view_line, view_count, KEY_A) & KEY_A) ? DIFF_SAVE : DIFF_CANCEL;
+}
@@ -0,0 +1,16 @@
+#ifndef DIFF_H
+#define DIFF_H
+
+#include "confedit.h"
+#include "textfile.h"
+
+enum {
+    DIFF_SAVE,          // User confirmed the changes
+    DIFF_UNCHANGED,     // Buffer is identical to the file, nothing to write
+    DIFF_CANCEL         // User went back to the editor
+};
+
+// Compare the edited lines with the file on disk and show the changed hunks
+int diff_preview(const char *filepath, char lines[][MAX_LINE_LENGTH], int count, const TextFileInfo *info);
+
+#endif // DIFF_H
@@ -0,0 +1,21 @@
+#include <nds.h>
+#include <stdio.h>
+#include <string.h>
+#include "fileio.h"
+
+void temp_path_for(const char *path, char *out, int size) {
+    snprintf(out, size, "%s.tmp", path);
+}
+
+bool commit_temp_file(const char *tmp_path, const char *path) {
+    // FAT rename does not overwrite, the old file has to go first
+    if (remove(path) != 0) {
+        FILE *check = fopen(path, "rb");
+        if (check) {
+            fclose(check);
+            remove(tmp_path);
+            return false;
+        }
+    }
+    return rename(tmp_path, path) == 0;
+}
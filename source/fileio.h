@@ -0,0 +1,13 @@
+#ifndef FILEIO_H
+#define FILEIO_H
+
+#include <nds.h>
+
+// Build the path of the temporary file used while rewriting path
+void temp_path_for(const char *path, char *out, int size);
+
+// Replace path with the fully written temporary file tmp_path.
+// The original is only removed once the new content is closed on the card.
+bool commit_temp_file(const char *tmp_path, const char *path);
+
+#endif // FILEIO_H
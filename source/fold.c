@@ -0,0 +1,240 @@
+#include <nds.h>
+#include <string.h>
+#include "confedit.h"
+#include "format.h"
+#include "fold.h"
+#include "hot.h"
+
+#define FOLD_SECTION    0x01    // INI section header
+#define FOLD_COLLAPSED  0x02    // Region starting here is collapsed
+#define FOLD_MAX_DEPTH  256     // Open brackets or tags tracked
+
+static int outline;         // OUTLINE_* of the file's format
+static int line_count;
+
+// Cached structure of each line, walked whole by find_regions() after every
+// edit, so in DTCM
+static s8 line_delta[MAX_LINES] HOT_BSS;    // Brackets or tags opened minus closed
+static u8 line_flags[MAX_LINES] HOT_BSS;
+
+// Regions, rebuilt from the cache when map_dirty is set
+static u16 region_end[MAX_LINES];   // Last line of the region starting here, 0 if none
+static bool map_dirty;
+
+// Hidden ranges, sorted: lines hidden_start[k]..hidden_end[k] are not shown,
+// hidden_before[k] lines are hidden before range k
+static u16 hidden_start[MAX_LINES / 2 + 1];
+static u16 hidden_end[MAX_LINES / 2 + 1];
+static u16 hidden_before[MAX_LINES / 2 + 1];
+static int hidden_count;
+static int hidden_total;
+
+static int json_delta(const char *line) {
+    int delta = 0;
+    bool in_string = false;
+    for (const char *p = line; *p; p++) {
+        if (in_string) {
+            if (*p == '\\' && p[1]) p++;
+            else if (*p == '"') in_string = false;
+        } else if (*p == '"') {
+            in_string = true;
+        } else if (*p == '{' || *p == '[') {
+            delta++;
+        } else if (*p == '}' || *p == ']') {
+            delta--;
+        }
+    }
+    return delta;
+}
+
+static int xml_delta(const char *line) {
+    int delta = 0;
+    for (const char *p = strchr(line, '<'); p; p = strchr(p + 1, '<')) {
+        if (p[1] == '/') {
+            delta--;
+        } else if (p[1] != '?' && p[1] != '!') {
+            // Self closing tags open nothing
+            const char *end = strchr(p, '>');
+            if (!end || end[-1] != '/') delta++;
+        }
+    }
+    return delta;
+}
+
+void fold_update_line(char lines[][MAX_LINE_LENGTH], int index) {
+    const char *line = lines[index];
+    int delta = 0;
+
+    line_flags[index] &= FOLD_COLLAPSED;
+    if (outline == OUTLINE_BRACKETS) {
+        delta = json_delta(line);
+    } else if (outline == OUTLINE_TAGS) {
+        delta = xml_delta(line);
+    } else if (outline == OUTLINE_SECTIONS) {
+        while (*line == ' ' || *line == '\t') line++;
+        if (*line == '[') line_flags[index] |= FOLD_SECTION;
+    }
+
+    line_delta[index] = (delta < -127) ? -127 : (delta > 127) ? 127 : delta;
+    map_dirty = true;
+}
+
+void fold_reset(int kind, char lines[][MAX_LINE_LENGTH], int total) {
+    outline = kind;
+
+    line_count = total;
+    memset(line_flags, 0, sizeof(line_flags));
+    for (int i = 0; i < total; i++) fold_update_line(lines, i);
+}
+
+void fold_insert_lines(int index, int count) {
+    int moved = line_count - index;
+    memmove(&line_delta[index + count], &line_delta[index], moved);
+    memmove(&line_flags[index + count], &line_flags[index], moved);
+    memset(&line_delta[index], 0, count);
+    memset(&line_flags[index], 0, count);
+    line_count += count;
+    map_dirty = true;
+}
+
+void fold_remove_lines(int index, int count) {
+    int moved = line_count - index - count;
+    memmove(&line_delta[index], &line_delta[index + count], moved);
+    memmove(&line_flags[index], &line_flags[index + count], moved);
+    line_count -= count;
+    map_dirty = true;
+}
+
+HOT_CODE static void find_regions(void) {
+    memset(region_end, 0, line_count * sizeof(u16));
+
+    if (outline == OUTLINE_NONE) return;
+
+    if (outline == OUTLINE_SECTIONS) {
+        int section = -1;
+        for (int i = 0; i <= line_count; i++) {
+            if (i < line_count && !(line_flags[i] & FOLD_SECTION)) continue;
+            if (section >= 0 && i - 1 > section) region_end[section] = i - 1;
+            section = i;
+        }
+        return;
+    }
+
+    // A line opening more than it closes starts a region, which ends on the
+    // line closing it again
+    static u16 stack[FOLD_MAX_DEPTH];
+    int depth = 0;
+    for (int i = 0; i < line_count; i++) {
+        int delta = line_delta[i];
+        for (; delta < 0 && depth > 0; delta++) {
+            int start = stack[--depth];
+            if (start != i) region_end[start] = i;
+        }
+        for (; delta > 0 && depth < FOLD_MAX_DEPTH; delta--) {
+            stack[depth++] = i;
+        }
+    }
+}
+
+static void build_map(void) {
+    find_regions();
+
+    hidden_count = 0;
+    hidden_total = 0;
+    for (int i = 0; i < line_count; i++) {
+        if (!(line_flags[i] & FOLD_COLLAPSED) || region_end[i] <= i) continue;
+
+        hidden_start[hidden_count] = i + 1;
+        hidden_end[hidden_count] = region_end[i];
+        hidden_before[hidden_count] = hidden_total;
+        hidden_total += region_end[i] - i;
+        hidden_count++;
+
+        // Regions inside a collapsed one are hidden with it
+        i = region_end[i];
+    }
+    map_dirty = false;
+}
+
+static void update_map(void) {
+    if (map_dirty) build_map();
+}
+
+// Last hidden range starting at or before line, -1 if none
+static int range_before_line(int line) {
+    int lo = 0, hi = hidden_count - 1, found = -1;
+    while (lo <= hi) {
+        int mid = (lo + hi) / 2;
+        if (hidden_start[mid] <= line) {
+            found = mid;
+            lo = mid + 1;
+        } else {
+            hi = mid - 1;
+        }
+    }
+    return found;
+}
+
+int fold_visible_rows(void) {
+    update_map();
+    return line_count - hidden_total;
+}
+
+int fold_row_to_line(int row) {
+    update_map();
+
+    // Last range whose first hidden line would be at or before row
+    int lo = 0, hi = hidden_count - 1, found = -1;
+    while (lo <= hi) {
+        int mid = (lo + hi) / 2;
+        if (hidden_start[mid] - hidden_before[mid] <= row) {
+            found = mid;
+            lo = mid + 1;
+        } else {
+            hi = mid - 1;
+        }
+    }
+    if (found < 0) return row;
+    return row + hidden_before[found] + (hidden_end[found] - hidden_start[found] + 1);
+}
+
+int fold_line_to_row(int line) {
+    update_map();
+
+    int k = range_before_line(line);
+    if (k < 0) return line;
+    if (line <= hidden_end[k]) return hidden_start[k] - 1 - hidden_before[k];
+    return line - hidden_before[k] - (hidden_end[k] - hidden_start[k] + 1);
+}
+
+int fold_hidden_after(int line) {
+    update_map();
+
+    int k = range_before_line(line + 1);
+    if (k < 0 || hidden_start[k] != line + 1) return 0;
+    return hidden_end[k] - hidden_start[k] + 1;
+}
+
+int fold_toggle(int line) {
+    update_map();
+
+    for (int start = line; start >= 0; start--) {
+        if (region_end[start] >= line && region_end[start] > start) {
+            line_flags[start] ^= FOLD_COLLAPSED;
+            map_dirty = true;
+            return start;
+        }
+    }
+    return -1;
+}
+
+void fold_reveal(int line) {
+    update_map();
+
+    for (int start = line - 1; start >= 0; start--) {
+        if ((line_flags[start] & FOLD_COLLAPSED) && region_end[start] >= line) {
+            line_flags[start] &= ~FOLD_COLLAPSED;
+            map_dirty = true;
+        }
+    }
+}
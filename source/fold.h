@@ -0,0 +1,41 @@
+#ifndef FOLD_H
+#define FOLD_H
+
+#include <nds.h>
+#include "confedit.h"
+
+// Folding of INI sections, JSON objects/arrays and XML elements, following
+// the outline of the file's format (format.h).
+// The structure of each line (section header, brackets or tags opened minus
+// closed) is cached when the line changes, so finding the regions again is
+// a pass over small integers. Collapsed regions form a sorted list of hidden
+// ranges, and screen rows are mapped to buffer lines by binary search in it.
+// The collapsed flag lives on the first line of a region, it follows the
+// line when lines are inserted or removed above it.
+
+// Forget all folds and read the structure of every line, outline is one of OUTLINE_*
+void fold_reset(int outline, char lines[][MAX_LINE_LENGTH], int total);
+
+// Call after changing the text of a line
+void fold_update_line(char lines[][MAX_LINE_LENGTH], int index);
+
+// Call after inserting or removing lines at index, then update the changed lines
+void fold_insert_lines(int index, int count);
+void fold_remove_lines(int index, int count);
+
+// Collapse or expand the innermost region holding line, returns its first
+// line or -1 if there is none
+int fold_toggle(int line);
+
+// Expand every collapsed region hiding line
+void fold_reveal(int line);
+
+// Rows left once collapsed regions are hidden, and mapping between rows and lines
+int fold_visible_rows(void);
+int fold_row_to_line(int row);
+int fold_line_to_row(int line);
+
+// Lines hidden after line, 0 if it does not start a collapsed region
+int fold_hidden_after(int line);
+
+#endif // FOLD_H
@@ -0,0 +1,104 @@
+// 4x8 font for the dense text mode, printable ASCII (32-126).
+// Each glyph is 8 rows of 4 pixels, row 0 in the top nibble,
+// leftmost pixel in the nibble's high bit. Glyphs are 3x6 pixels
+// drawn from row 1, the right column and last row are spacing.
+
+#include "font4x8.h"
+
+const unsigned int font4x8[FONT4X8_GLYPHS] = {
+    0x00000000,  // ' '
+    0x04440400,  // '!'
+    0x0AA00000,  // '"'
+    0x0AEAEA00,  // '#'
+    0x06C46C00,  // '$'
+    0x08248200,  // '%'
+    0x04A4A600,  // '&'
+    0x04400000,  // '\''
+    0x02444200,  // '('
+    0x08444800,  // ')'
+    0x00A4A000,  // '*'
+    0x004E4000,  // '+'
+    0x00004480,  // ','
+    0x000E0000,  // '-'
+    0x00000400,  // '.'
+    0x02248800,  // '/'
+    0x06AAAC00,  // '0'
+    0x04C44E00,  // '1'
+    0x0C248E00,  // '2'
+    0x0C242C00,  // '3'
+    0x0AAE2200,  // '4'
+    0x0E8C2C00,  // '5'
+    0x068EAE00,  // '6'
+    0x0E248800,  // '7'
+    0x0EAEAE00,  // '8'
+    0x0EAE2C00,  // '9'
+    0x00404000,  // ':'
+    0x00404480,  // ';'
+    0x02484200,  // '<'
+    0x00E0E000,  // '='
+    0x08424800,  // '>'
+    0x0C240400,  // '?'
+    0x04AE8600,  // '@'
+    0x04AEAA00,  // 'A'
+    0x0CACAC00,  // 'B'
+    0x06888600,  // 'C'
+    0x0CAAAC00,  // 'D'
+    0x0E8E8E00,  // 'E'
+    0x0E8E8800,  // 'F'
+    0x068AA600,  // 'G'
+    0x0AAEAA00,  // 'H'
+    0x0E444E00,  // 'I'
+    0x0222A400,  // 'J'
+    0x0AACAA00,  // 'K'
+    0x08888E00,  // 'L'
+    0x0AEEAA00,  // 'M'
+    0x0AEEEA00,  // 'N'
+    0x04AAA400,  // 'O'
+    0x0CAC8800,  // 'P'
+    0x04AAE600,  // 'Q'
+    0x0CAECA00,  // 'R'
+    0x06842C00,  // 'S'
+    0x0E444400,  // 'T'
+    0x0AAAA600,  // 'U'
+    0x0AAA4400,  // 'V'
+    0x0AAEEA00,  // 'W'
+    0x0AA4AA00,  // 'X'
+    0x0AA44400,  // 'Y'
+    0x0E248E00,  // 'Z'
+    0x0E888E00,  // '['
+    0x08842200,  // '\\'
+    0x0E222E00,  // ']'
+    0x04A00000,  // '^'
+    0x00000E00,  // '_'
+    0x08400000,  // '`'
+    0x00C6AE00,  // 'a'
+    0x08CAAC00,  // 'b'
+    0x00688600,  // 'c'
+    0x026AA600,  // 'd'
+    0x006AC600,  // 'e'
+    0x024E4400,  // 'f'
+    0x006A62C0,  // 'g'
+    0x08CAAA00,  // 'h'
+    0x04044400,  // 'i'
+    0x02022A40,  // 'j'
+    0x08ACCA00,  // 'k'
+    0x0C444E00,  // 'l'
+    0x00EEEA00,  // 'm'
+    0x00CAAA00,  // 'n'
+    0x004AA400,  // 'o'
+    0x00CAAC80,  // 'p'
+    0x006AA620,  // 'q'
+    0x00688800,  // 'r'
+    0x006C6C00,  // 's'
+    0x04E44600,  // 't'
+    0x00AAA600,  // 'u'
+    0x00AAE400,  // 'v'
+    0x00AEEE00,  // 'w'
+    0x00A44A00,  // 'x'
+    0x00AA62C0,  // 'y'
+    0x00E6CE00,  // 'z'
+    0x064C4600,  // '{'
+    0x04444400,  // '|'
+    0x0C464C00,  // '}'
+    0x006C0000,  // '~'
+};
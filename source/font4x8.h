@@ -0,0 +1,9 @@
+#ifndef FONT4X8_H
+#define FONT4X8_H
+
+#define FONT4X8_FIRST   32
+#define FONT4X8_GLYPHS  95
+
+extern const unsigned int font4x8[FONT4X8_GLYPHS];
+
+#endif // FONT4X8_H
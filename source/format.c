@@ -0,0 +1,203 @@
+#include <nds.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include "confedit.h"
+#include "textfile.h"
+#include "format.h"
+
+#define FORMATS_PATH    CONFEDIT_DIR "/formats.txt"
+#define FNV_BASIS       2166136261u
+#define FNV_PRIME       16777619u
+
+enum {
+    FORMAT_INI,
+    FORMAT_TEXT,
+    FORMAT_CONF,
+    FORMAT_JSON,
+    FORMAT_XML,
+    FORMAT_TOML,
+    FORMAT_YAML,
+    FORMAT_PROPERTIES,
+    FORMAT_COUNT
+};
+
+// Files with line endings keep theirs. The eol of a format is for files
+// without any: INI files mostly come from Windows tools, CRLF then.
+static const Format formats[FORMAT_COUNT] = {
+    [FORMAT_INI] = {
+        .name = "ini", .extensions = "ini cfg",
+        .outline = OUTLINE_SECTIONS, .comments = "#;", .separators = "=",
+        .schema = true, .eol = EOL_CRLF,
+    },
+    [FORMAT_TEXT] = {
+        .name = "text", .extensions = "txt",
+        .outline = OUTLINE_SECTIONS, .comments = "#;", .separators = "=:",
+        .schema = true, .sniff = true, .eol = EOL_LF,
+    },
+    [FORMAT_CONF] = {
+        .name = "conf", .extensions = "conf",
+        .outline = OUTLINE_SECTIONS, .comments = "#;", .separators = "=",
+        .schema = true, .sniff = true, .eol = EOL_LF,
+    },
+    [FORMAT_JSON] = {
+        .name = "json", .extensions = "json",
+        .outline = OUTLINE_BRACKETS, .comments = "", .separators = ":",
+        .eol = EOL_LF,
+    },
+    [FORMAT_XML] = {
+        .name = "xml", .extensions = "xml",
+        .outline = OUTLINE_TAGS, .comments = "", .separators = "=",
+        .eol = EOL_LF,
+    },
+    [FORMAT_TOML] = {
+        .name = "toml", .extensions = "toml",
+        .outline = OUTLINE_SECTIONS, .comments = "#", .separators = "=",
+        .schema = true, .eol = EOL_LF,
+    },
+    [FORMAT_YAML] = {
+        .name = "yaml", .extensions = "yaml yml",
+        .outline = OUTLINE_NONE, .comments = "#", .separators = ":",
+        .eol = EOL_LF,
+    },
+    [FORMAT_PROPERTIES] = {
+        .name = "properties", .extensions = "properties",
+        .outline = OUTLINE_NONE, .comments = "#!", .separators = "=:",
+        .schema = true, .eol = EOL_LF,
+    },
+};
+
+#define SLOT_FREE       0
+#define SLOT_HIDDEN     -1      // Extension removed by formats.txt
+
+typedef struct {
+    u32 hash;
+    s8 format;                  // Index in formats + 1, or one of the above
+    char ext[FORMAT_MAX_EXT + 1];
+} ExtSlot;
+
+static ExtSlot table[FORMAT_TABLE_SIZE];
+static int slots_used;
+
+// Hash of an extension, FNV-1a over its lowercase characters
+static u32 hash_ext(const char *ext, int len) {
+    u32 hash = FNV_BASIS;
+    for (int i = 0; i < len; i++) hash = (hash ^ (u8)tolower((unsigned char)ext[i])) * FNV_PRIME;
+    return hash;
+}
+
+// Slot of the extension, or the free slot where it would go
+static ExtSlot *find_slot(u32 hash, const char *ext, int len) {
+    int i = hash & (FORMAT_TABLE_SIZE - 1);
+    while (table[i].format != SLOT_FREE) {
+        if (table[i].hash == hash && strncasecmp(table[i].ext, ext, len) == 0 && table[i].ext[len] == '\0')
+            return &table[i];
+        i = (i + 1) & (FORMAT_TABLE_SIZE - 1);
+    }
+    return &table[i];
+}
+
+// Map ext to format, replacing what it was mapped to. The table stays at
+// most half full so probing stays short.
+static void set_ext(const char *ext, int len, int format) {
+    if (len <= 0 || len > FORMAT_MAX_EXT) return;
+
+    u32 hash = hash_ext(ext, len);
+    ExtSlot *slot = find_slot(hash, ext, len);
+    if (slot->format == SLOT_FREE) {
+        if (slots_used >= FORMAT_TABLE_SIZE / 2) return;
+        slots_used++;
+        slot->hash = hash;
+        memcpy(slot->ext, ext, len);
+        slot->ext[len] = '\0';
+    }
+    slot->format = format;
+}
+
+static void load_formats_file(void) {
+    FILE *file = fopen(FORMATS_PATH, "rb");
+    if (!file) return;
+
+    char line[MAX_LINE_LENGTH];
+    while (fgets(line, sizeof(line), file)) {
+        char *ext = strtok(line, " \t\r\n");
+        char *name = strtok(NULL, " \t\r\n");
+        if (!ext || !name || ext[0] == '#') continue;
+        if (ext[0] == '.') ext++;
+
+        int format = (strcasecmp(name, "none") == 0) ? SLOT_HIDDEN : SLOT_FREE;
+        for (int f = 0; f < FORMAT_COUNT && format == SLOT_FREE; f++) {
+            if (strcasecmp(name, formats[f].name) == 0) format = f + 1;
+        }
+        if (format != SLOT_FREE) set_ext(ext, strlen(ext), format);
+    }
+    fclose(file);
+}
+
+void format_init(void) {
+    memset(table, 0, sizeof(table));
+    slots_used = 0;
+
+    for (int f = 0; f < FORMAT_COUNT; f++) {
+        const char *ext = formats[f].extensions;
+        while (*ext) {
+            int len = strcspn(ext, " ");
+            set_ext(ext, len, f + 1);
+            ext += len;
+            while (*ext == ' ') ext++;
+        }
+    }
+    load_formats_file();
+}
+
+const Format *format_of_name(const char *name) {
+    // The hash restarts at each dot, so it ends as the hash of the last extension
+    u32 hash = FNV_BASIS;
+    int ext = -1, i;
+    for (i = 0; name[i]; i++) {
+        if (name[i] == '.') {
+            hash = FNV_BASIS;
+            ext = i + 1;
+        } else {
+            hash = (hash ^ (u8)tolower((unsigned char)name[i])) * FNV_PRIME;
+        }
+    }
+    if (ext < 0 || i == ext || i - ext > FORMAT_MAX_EXT) return NULL;
+
+    const ExtSlot *slot = find_slot(hash, name + ext, i - ext);
+    return (slot->format > 0) ? &formats[slot->format - 1] : NULL;
+}
+
+// JSON or XML from the first line holding something, NULL if it is neither
+static const Format *sniff(char lines[][MAX_LINE_LENGTH], int total) {
+    for (int l = 0; l < total; l++) {
+        const char *p = lines[l];
+        while (*p == ' ' || *p == '\t') p++;
+        if (*p == '\0') continue;
+
+        if (*p == '<') return &formats[FORMAT_XML];
+        if (*p == '{') return &formats[FORMAT_JSON];
+        if (*p == '[') {
+            // An array, not an INI section header
+            p++;
+            while (*p == ' ' || *p == '\t') p++;
+            if (*p == '\0' || *p == '{' || *p == '[' || *p == '"' || isdigit((unsigned char)*p))
+                return &formats[FORMAT_JSON];
+        }
+        return NULL;
+    }
+    return NULL;
+}
+
+const Format *format_of_file(const char *path, char lines[][MAX_LINE_LENGTH], int total) {
+    const char *slash = strrchr(path, '/');
+    const Format *format = format_of_name(slash ? slash + 1 : path);
+    if (!format) format = &formats[FORMAT_TEXT];
+
+    if (format->sniff) {
+        const Format *found = sniff(lines, total);
+        if (found) format = found;
+    }
+    return format;
+}
@@ -0,0 +1,50 @@
+#ifndef FORMAT_H
+#define FORMAT_H
+
+#include <nds.h>
+#include "confedit.h"
+
+// File formats the editor opens. A descriptor tells the other modules how
+// to read the lines of a format: comment lines, key/value separators, how
+// fold regions are found, whether schemas apply and the line ending of a
+// file that has none yet. The format of a file comes from its extension,
+// looked up in a hash table of the built-in extensions and of
+//   /_nds/ConfEdit/formats.txt, one "<extension> <format>" per line,
+//   e.g. "nfo text", or "<extension> none" to stop listing an extension.
+// Formats marked sniff give way to JSON or XML when the first line of the
+// file says so.
+
+#define FORMAT_MAX_EXT      12      // Longest extension, without the dot
+#define FORMAT_TABLE_SIZE   64      // Hash slots, a power of two
+
+// How fold regions are found
+enum {
+    OUTLINE_NONE,
+    OUTLINE_SECTIONS,       // [section] headers
+    OUTLINE_BRACKETS,       // JSON objects and arrays
+    OUTLINE_TAGS            // XML elements
+};
+
+typedef struct {
+    const char *name;           // Used in formats.txt
+    const char *extensions;     // Built-in extensions, separated by spaces
+    u8 outline;
+    const char *comments;       // Characters starting a comment line
+    const char *separators;     // Characters between a key and its value
+    bool schema;                // Lines are key = value, schemas apply
+    bool sniff;                 // The content may turn out to be JSON or XML
+    u8 eol;                     // Ending of new lines in a file without any
+} Format;
+
+// Build the extension table, with the changes of formats.txt
+void format_init(void);
+
+// Format of a file name from its extension, NULL if the editor does not open it.
+// The name is read once, hashing the extension on the way.
+const Format *format_of_name(const char *name);
+
+// Format of a loaded file, its content deciding for the formats marked sniff.
+// Never NULL, files the table does not know are plain text.
+const Format *format_of_file(const char *path, char lines[][MAX_LINE_LENGTH], int total);
+
+#endif // FORMAT_H
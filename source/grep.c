@@ -0,0 +1,358 @@
+#include <nds.h>
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <dirent.h>
+#include "confedit.h"
+#include "input.h"
+#include "textfile.h"
+#include "ui.h"
+#include "grep.h"
+
+#define GREP_BLOCK_SIZE   (32 * 1024)        // Bytes read from the card at once
+#define GREP_MAX_PATTERN  64                 // Max length of the search pattern
+#define GREP_MAX_RESULTS  256                // Max number of matching lines kept
+#define GREP_MAX_PENDING  32                 // Max directories waiting to be scanned
+#define GREP_SLICE_TICKS  (BUS_CLOCK / 100)  // ~10ms of search work per frame
+#define GREP_PREVIEW_LEN  (SCREEN_COLUMNS - 2)
+
+typedef struct {
+    char path[MAX_PATH_LEN];
+    int line;                              // 0-based line of the match
+    char preview[GREP_PREVIEW_LEN + 1];    // Start of the matching line
+} GrepResult;
+
+static GrepResult results[GREP_MAX_RESULTS];
+static int result_count;
+
+// Pattern and its Horspool skip table
+static char pattern[GREP_MAX_PATTERN];
+static int pattern_len;
+static int skip_table[256];
+
+// Directories still to visit, used as a stack
+static char pending[GREP_MAX_PENDING][MAX_PATH_LEN];
+static int pending_count;
+static bool search_recursive;
+
+static DIR *dir;
+static char dir_path[MAX_PATH_LEN];
+
+static FILE *file;
+static char file_path[MAX_PATH_LEN];
+static int file_carry;         // Bytes kept from the previous block
+static int file_pos;           // Block offset where counting resumes
+static int file_line;          // Line number at file_pos, as load_text_file() numbers it
+static int file_col;           // Bytes of that line before file_pos
+static bool file_cr;           // Last line ended in CR, a LF right after belongs to it
+static bool file_skip_line;    // Current line already matched, skip to its end
+
+static u8 block[GREP_BLOCK_SIZE + GREP_MAX_PATTERN] ALIGN(32);
+
+// Statistics
+static int files_scanned;
+static u32 bytes_scanned;
+static bool truncated;
+
+static void build_skip_table(void) {
+    for (int i = 0; i < 256; i++)
+        skip_table[i] = pattern_len;
+    for (int i = 0; i < pattern_len - 1; i++)
+        skip_table[(u8)pattern[i]] = pattern_len - 1 - i;
+}
+
+// Boyer-Moore-Horspool search in hay[from..n), returns match offset or -1
+static int find_pattern(const u8 *hay, int from, int n) {
+    int last = pattern_len - 1;
+    u8 last_char = (u8)pattern[last];
+
+    while (from + last < n) {
+        u8 c = hay[from + last];
+        if (c == last_char && memcmp(hay + from, pattern, last) == 0)
+            return from;
+        from += skip_table[c];
+    }
+    return -1;
+}
+
+// Count lines over buf[pos..to) the way text_reader_next() splits them: at
+// LF, CR and CRLF, and before a byte or UTF-8 sequence that would make the
+// line longer than MAX_LINE_LENGTH - 1. Stops early once file_line reaches
+// until_line. Returns where counting stopped, which is past to when the last
+// sequence crosses it; sequences are read up to avail.
+static int count_lines(const u8 *buf, int pos, int to, int avail, int until_line) {
+    while (pos < to && file_line < until_line) {
+        u8 c = buf[pos];
+        if (file_cr) {
+            file_cr = false;
+            if (c == '\n') {
+                pos++;
+                continue;
+            }
+        }
+
+        int n = 1;
+        if (c >= 0x80) {
+            int seq = utf8_sequence(buf + pos, avail - pos);
+            if (seq > 0) n = seq;
+        }
+
+        if (file_col + n > MAX_LINE_LENGTH - 1) {
+            // Split before this byte, it starts the next line
+            file_line++;
+            file_col = 0;
+        } else if (c == '\n' || c == '\r') {
+            file_line++;
+            file_col = 0;
+            file_cr = (c == '\r');
+            pos++;
+        } else {
+            file_col += n;
+            pos += n;
+        }
+    }
+    return pos;
+}
+
+static void add_result(const u8 *buf, int match, int n) {
+    if (result_count >= GREP_MAX_RESULTS) {
+        truncated = true;
+        return;
+    }
+
+    GrepResult *r = &results[result_count++];
+    strcpy(r->path, file_path);
+    r->line = file_line;
+
+    // Back up to the start of the line if it is still in the buffer
+    int start = match;
+    while (start > 0 && buf[start - 1] != '\n' && buf[start - 1] != '\r' && match - start < GREP_PREVIEW_LEN / 2)
+        start--;
+
+    int len = 0;
+    while (start + len < n && len < GREP_PREVIEW_LEN && buf[start + len] != '\n' && buf[start + len] != '\r') {
+        u8 c = buf[start + len];
+        r->preview[len++] = (c >= 32 && c <= 126) ? c : '.';
+    }
+    r->preview[len] = '\0';
+}
+
+static bool open_next_file(const char *path) {
+    file = fopen(path, "rb");
+    if (!file) return false;
+
+    strcpy(file_path, path);
+    file_carry = 0;
+    file_pos = 0;
+    file_line = 0;
+    file_col = 0;
+    file_cr = false;
+    file_skip_line = false;
+    return true;
+}
+
+// Read and scan one block of the current file
+static void scan_block(void) {
+    int n = fread(block + file_carry, 1, GREP_BLOCK_SIZE, file);
+    bytes_scanned += n;
+
+    int total = file_carry + n;
+    bool eof = (n < GREP_BLOCK_SIZE);
+
+    // Keep the last bytes so matches and UTF-8 sequences across blocks are
+    // seen whole. Matches starting in them are left to the next block.
+    int keep = eof ? 0 : (pattern_len > 4 ? pattern_len - 1 : 3);
+    if (keep > total) keep = total;
+    int cut = total - keep;
+
+    int pos = file_pos;    // Where the search resumes, lines before it are counted
+
+    // Only the first block has no carry. The loader drops the byte order mark.
+    if (file_carry == 0 && total >= 3 && memcmp(block, "\xEF\xBB\xBF", 3) == 0)
+        pos = 3;
+
+    while (pos < cut) {
+        if (file_skip_line) {
+            int line = file_line;
+            pos = count_lines(block, pos, cut, total, line + 1);
+            file_skip_line = (file_line == line);
+            continue;
+        }
+
+        int match = find_pattern(block, pos, total);
+        if (match < 0 || match >= cut) break;
+
+        // Count through the first byte, a line split before it moves the hit
+        pos = count_lines(block, pos, match + 1, total, INT_MAX);
+        add_result(block, match, total);
+
+        // One result per line: continue after the end of this line
+        file_skip_line = true;
+    }
+
+    if (pos < cut)
+        pos = count_lines(block, pos, cut, total, INT_MAX);
+
+    if (eof) {
+        fclose(file);
+        file = NULL;
+        files_scanned++;
+        return;
+    }
+
+    memmove(block, block + cut, keep);
+    file_carry = keep;
+    file_pos = pos - cut;
+}
+
+// Advance the search by one unit of work, returns false once everything is scanned
+static bool grep_step(void) {
+    if (file) {
+        scan_block();
+        return true;
+    }
+
+    if (dir) {
+        struct dirent *pent = readdir(dir);
+        if (!pent) {
+            closedir(dir);
+            dir = NULL;
+            return true;
+        }
+        if (strcmp(".", pent->d_name) == 0 || strcmp("..", pent->d_name) == 0)
+            return true;
+
+        char path[MAX_PATH_LEN];
+        snprintf(path, sizeof(path), "%s%s%s", dir_path,
+                 (strcmp(dir_path, "/") == 0) ? "" : "/", pent->d_name);
+
+        if (pent->d_type == DT_DIR) {
+            if (search_recursive && pending_count < GREP_MAX_PENDING)
+                strcpy(pending[pending_count++], path);
+        } else if (is_supported_file(pent->d_name)) {
+            open_next_file(path);
+        }
+        return true;
+    }
+
+    if (pending_count > 0) {
+        strcpy(dir_path, pending[--pending_count]);
+        dir = opendir(dir_path);
+        return true;
+    }
+
+    return false;
+}
+
+static void grep_stop(void) {
+    if (file) fclose(file);
+    if (dir) closedir(dir);
+    file = NULL;
+    dir = NULL;
+    pending_count = 0;
+}
+
+static void print_rate(int frames) {
+    if (frames < 1) frames = 1;
+    iprintf("%d files, %lu KB in %d.%02ds\n", files_scanned,
+            (unsigned long)(bytes_scanned / 1024), frames / 60, (frames % 60) * 100 / 60);
+    iprintf("%d files/s, %lu KB/s\n", files_scanned * 60 / frames,
+            (unsigned long)((u64)bytes_scanned * 60 / 1024 / frames));
+}
+
+// Run the search time-sliced across frames, returns false if cancelled
+static bool grep_search(const char *root, int *frames) {
+    result_count = 0;
+    files_scanned = 0;
+    bytes_scanned = 0;
+    truncated = false;
+    pending_count = 0;
+    strcpy(pending[pending_count++], root);
+    *frames = 0;
+
+    bool running = true;
+    while (running) {
+        cpuStartTiming(0);
+        while ((running = grep_step()) && cpuGetTiming() < GREP_SLICE_TICKS)
+            ;
+        cpuEndTiming();
+
+        consoleClear();
+        iprintf("\x1b[1;1HSearching \"%s\"\n\n", pattern);
+        print_rate(*frames);
+        iprintf("\n%d matches\n\nB: stop", result_count);
+
+        if (input_keys_down() & KEY_B) {
+            grep_stop();
+            return false;
+        }
+
+        swiWaitForVBlank();
+        (*frames)++;
+    }
+    return true;
+}
+
+static void draw_results(int cursor, int scroll, int root_len, int frames) {
+    consoleClear();
+    iprintf("\x1b[1;1H\"%s\": %d%s matches", pattern, result_count, truncated ? "+" : "");
+
+    int end = (scroll + MAX_VISIBLE_LINES - 4 < result_count) ? scroll + MAX_VISIBLE_LINES - 4 : result_count;
+    for (int i = scroll; i < end; i++) {
+        const char *name = results[i].path + root_len;
+        if (*name == '/') name++;
+        iprintf("\x1b[%d;1H%s%.24s:%d", i - scroll + TOP_MARGIN + 1,
+                (i == cursor) ? "> " : "  ", name, results[i].line + 1);
+    }
+
+    iprintf("\x1b[%d;1H", SCREEN_LINES - 3);
+    if (result_count > 0) iprintf("%s\n", results[cursor].preview);
+    print_rate(frames);
+}
+
+const char *grep_pattern(void) {
+    return pattern;
+}
+
+void grep_run(const char *root, bool recursive) {
+    char input[GREP_MAX_PATTERN] = "";
+    if (!ui_prompt(recursive ? "Search in folder and subfolders:" : "Search in folder:", input, sizeof(input)))
+        return;
+    if (input[0] == '\0') return;
+
+    strcpy(pattern, input);
+    pattern_len = strlen(pattern);
+    build_skip_table();
+    search_recursive = recursive;
+
+    int frames;
+    grep_search(root, &frames);
+
+    int root_len = strlen(root);
+    int cursor = 0, scroll = 0;
+    int page = MAX_VISIBLE_LINES - 4;
+
+    while (1) {
+        draw_results(cursor, scroll, root_len, frames);
+
+        int keys_down = input_keys_down();
+
+        if ((keys_down & KEY_UP) && cursor > 0) cursor--;
+        if ((keys_down & KEY_DOWN) && cursor < result_count - 1) cursor++;
+        if (keys_down & KEY_LEFT) cursor = (cursor > SKIP_LINES) ? cursor - SKIP_LINES : 0;
+        if (keys_down & KEY_RIGHT) cursor = (cursor + SKIP_LINES < result_count) ? cursor + SKIP_LINES : result_count - 1;
+        if (cursor < 0) cursor = 0;
+
+        if (cursor < scroll) scroll = cursor;
+        if (cursor >= scroll + page) scroll = cursor - page + 1;
+
+        if ((keys_down & KEY_A) && result_count > 0) {
+            view_text_file(results[cursor].path, results[cursor].line);
+            consoleDemoInit();
+        }
+
+        if (keys_down & KEY_B) break;
+
+        swiWaitForVBlank();
+    }
+}
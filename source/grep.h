@@ -0,0 +1,13 @@
+#ifndef GREP_H
+#define GREP_H
+
+#include <nds.h>
+
+// Search every supported file under dir for a pattern typed by the user,
+// then show the matches in a list that opens the editor on the matching line
+void grep_run(const char *dir, bool recursive);
+
+// Pattern of the last search, empty before the first one
+const char *grep_pattern(void);
+
+#endif // GREP_H
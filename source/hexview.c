@@ -0,0 +1,297 @@
+#include <nds.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "confedit.h"
+#include "input.h"
+#include "ui.h"
+#include "dense.h"
+#include "hexview.h"
+
+typedef struct {
+    u32 index;                  // Page number in the file
+    int len;                    // Bytes read, less than HEX_PAGE_SIZE at the end of the file
+    u32 used;                   // Frame the page was last used in
+    bool valid;
+    u8 data[HEX_PAGE_SIZE];
+} HexPage;
+
+static HexPage *pages;
+static int page_count;
+static FILE *file;
+static u32 file_size;
+static u32 frame;
+
+// Search pattern and the last match
+static u8 pattern[HEX_MAX_PATTERN];
+static int pattern_len;
+static u32 match_offset;
+static bool match_found;
+
+static u8 scan[HEX_PAGE_SIZE + HEX_MAX_PATTERN];
+
+bool hexview_init(int count) {
+    pages = calloc(count, sizeof(HexPage));
+    page_count = pages ? count : 0;
+    return pages != NULL;
+}
+
+// Page holding index, read into the least recently used slot if needed
+static HexPage *get_page(u32 index) {
+    HexPage *victim = &pages[0];
+    for (int i = 0; i < page_count; i++) {
+        HexPage *page = &pages[i];
+        if (page->valid && page->index == index) {
+            page->used = frame;
+            return page;
+        }
+        if (!page->valid || (victim->valid && page->used < victim->used)) victim = page;
+    }
+
+    victim->index = index;
+    victim->used = frame;
+    victim->valid = true;
+    victim->len = 0;
+    if (fseek(file, index * HEX_PAGE_SIZE, SEEK_SET) == 0)
+        victim->len = fread(victim->data, 1, HEX_PAGE_SIZE, file);
+    return victim;
+}
+
+static bool page_cached(u32 index) {
+    for (int i = 0; i < page_count; i++) {
+        if (pages[i].valid && pages[i].index == index) return true;
+    }
+    return false;
+}
+
+// Byte at offset, -1 past the end of the file
+static int byte_at(u32 offset) {
+    if (offset >= file_size) return -1;
+    HexPage *page = get_page(offset / HEX_PAGE_SIZE);
+    int i = offset % HEX_PAGE_SIZE;
+    return (i < page->len) ? page->data[i] : -1;
+}
+
+static bool in_match(u32 offset) {
+    return match_found && offset >= match_offset && offset < match_offset + pattern_len;
+}
+
+// One row: offset, hex bytes in groups of 4 when there is room, then ASCII
+static void format_row(char *out, u32 offset, int per_row, bool dense) {
+    int pos = sprintf(out, dense ? "%08lX " : "%06lX:", (unsigned long)offset);
+    for (int i = 0; i < per_row; i++) {
+        int b = byte_at(offset + i);
+        if (dense && i > 0 && i % 4 == 0) out[pos++] = ' ';
+        if (b < 0) pos += sprintf(out + pos, "  ");
+        else pos += sprintf(out + pos, "%02X", b);
+    }
+    out[pos++] = ' ';
+    for (int i = 0; i < per_row; i++) {
+        int b = byte_at(offset + i);
+        out[pos++] = (b < 0) ? ' ' : (b >= 32 && b <= 126) ? b : '.';
+    }
+    out[pos] = '\0';
+}
+
+static void draw(const char *filepath, u32 top, int per_row, bool dense, const char *status) {
+    char row[DENSE_COLUMNS + 1];
+    const char *name = strrchr(filepath, '/');
+    name = name ? name + 1 : filepath;
+
+    if (!dense) {
+        consoleClear();
+        iprintf("\x1b[1;1H%.32s", name);
+        iprintf("\x1b[2;1H%.32s", status);
+        for (int i = 0; i < MAX_VISIBLE_LINES; i++) {
+            u32 offset = (top + i) * per_row;
+            if (offset >= file_size) break;
+            format_row(row, offset, per_row, false);
+            iprintf("\x1b[%d;1H%s", i + TOP_MARGIN + 1, row);
+        }
+        return;
+    }
+
+    dense_attach(false);
+    dense_clear();
+    dense_print(0, 0, name, DENSE_DIM);
+    dense_print(1, 0, status, DENSE_DIM);
+    for (int i = 0; i < MAX_VISIBLE_LINES; i++) {
+        u32 offset = (top + i) * per_row;
+        if (offset >= file_size) break;
+        format_row(row, offset, per_row, true);
+        dense_print(i + TOP_MARGIN, 0, row, DENSE_NORMAL);
+
+        // Highlight the match in both columns
+        for (int b = 0; b < per_row; b++) {
+            if (!in_match(offset + b)) continue;
+            int hex_col = 9 + b * 2 + b / 4;
+            int ascii_col = 9 + per_row * 2 + (per_row - 1) / 4 + 1 + b;
+            dense_put(i + TOP_MARGIN, hex_col, row[hex_col], DENSE_INVERSE);
+            dense_put(i + TOP_MARGIN, hex_col + 1, row[hex_col + 1], DENSE_INVERSE);
+            dense_put(i + TOP_MARGIN, ascii_col, row[ascii_col], DENSE_INVERSE);
+        }
+    }
+    dense_flush();
+}
+
+// Pattern typed as hex bytes ("DE AD BE EF") or as text in quotes ("\"abc\"")
+static bool parse_pattern(const char *text) {
+    pattern_len = 0;
+    if (text[0] == '"') {
+        for (const char *p = text + 1; *p && *p != '"' && pattern_len < HEX_MAX_PATTERN; p++)
+            pattern[pattern_len++] = *p;
+        return pattern_len > 0;
+    }
+
+    int nibbles = 0;
+    for (const char *p = text; *p; p++) {
+        if (*p == ' ') continue;
+        if (!isxdigit((unsigned char)*p) || pattern_len >= HEX_MAX_PATTERN) return false;
+        int v = isdigit((unsigned char)*p) ? *p - '0' : tolower((unsigned char)*p) - 'a' + 10;
+        if (nibbles % 2 == 0) pattern[pattern_len] = v << 4;
+        else pattern[pattern_len++] |= v;
+        nibbles++;
+    }
+    return nibbles > 0 && nibbles % 2 == 0;
+}
+
+// Find the pattern from offset on, reading the file in blocks with the
+// last pattern_len - 1 bytes of each block carried over. B cancels.
+static bool search_from(u32 offset) {
+    int carry = 0;
+    u32 base = offset;     // File offset of scan[0]
+
+    if (fseek(file, offset, SEEK_SET) != 0) return false;
+
+    for (u32 block = 0;; block++) {
+        int n = fread(scan + carry, 1, HEX_PAGE_SIZE, file);
+        int avail = carry + n;
+        if (avail < pattern_len) return false;
+
+        for (int i = 0; i <= avail - pattern_len; i++) {
+            const u8 *p = memchr(scan + i, pattern[0], avail - pattern_len + 1 - i);
+            if (!p) break;
+            i = p - scan;
+            if (memcmp(p, pattern, pattern_len) == 0) {
+                match_offset = base + i;
+                return true;
+            }
+        }
+        if (n < HEX_PAGE_SIZE) return false;
+
+        if (block % 64 == 0) {
+            iprintf("\x1b[2;1HSearching... %lu%%  B: stop ", (unsigned long)((u64)(base + avail) * 100 / file_size));
+            if (input_keys_held() & KEY_B) return false;
+        }
+
+        carry = pattern_len - 1;
+        memmove(scan, scan + avail - carry, carry);
+        base += avail - carry;
+    }
+}
+
+void hexview_run(const char *filepath, bool dense) {
+    file = fopen(filepath, "rb");
+    if (!file) {
+        ui_message("Failed to open file.");
+        return;
+    }
+    fseek(file, 0, SEEK_END);
+    file_size = ftell(file);
+
+    for (int i = 0; i < page_count; i++) pages[i].valid = false;
+    match_found = false;
+
+    int per_row = dense ? 16 : 8;
+    int total_rows = (file_size + per_row - 1) / per_row;
+    int max_top = total_rows - MAX_VISIBLE_LINES;
+    if (max_top < 0) max_top = 0;
+
+    int top = 0;
+    int direction = 1;
+    char status[DENSE_COLUMNS + 1];
+    snprintf(status, sizeof(status), "%luB  X:go to Y:find A:next", (unsigned long)file_size);
+
+    while (1) {
+        frame++;
+        draw(filepath, top, per_row, dense, status);
+
+        // Prefetch the page after the screen in the scroll direction
+        u32 first_page = (u32)top * per_row / HEX_PAGE_SIZE;
+        u32 last_page = ((u32)(top + MAX_VISIBLE_LINES) * per_row - 1) / HEX_PAGE_SIZE;
+        u32 ahead = (direction > 0) ? last_page + 1 : first_page - 1;
+        if ((direction > 0 || first_page > 0) && ahead * HEX_PAGE_SIZE < file_size && !page_cached(ahead))
+            get_page(ahead);
+
+        u32 keys_down = input_keys_down();
+        u32 keys_held = input_keys_held();
+
+        if (keys_held & KEY_UP) {
+            top--;
+            direction = -1;
+        }
+        if (keys_held & KEY_DOWN) {
+            top++;
+            direction = 1;
+        }
+        if (keys_down & KEY_LEFT) {
+            top -= MAX_VISIBLE_LINES;
+            direction = -1;
+        }
+        if (keys_down & KEY_RIGHT) {
+            top += MAX_VISIBLE_LINES;
+            direction = 1;
+        }
+
+        if (keys_down & KEY_B) break;
+
+        // Dialogs and the search progress use the console
+        if ((keys_down & (KEY_X | KEY_Y | KEY_A)) && dense) {
+            dense_detach();
+            consoleDemoInit();
+        }
+
+        if (keys_down & KEY_X) {
+            char text[16] = "";
+            if (ui_prompt("Go to offset (hex)", text, sizeof(text))) {
+                top = strtoul(text, NULL, 16) / per_row;
+                direction = 1;
+            }
+        }
+
+        bool search = false;
+        if (keys_down & KEY_Y) {
+            char text[2 * HEX_MAX_PATTERN + 8] = "";
+            if (ui_prompt("Find hex bytes, or \"text\"", text, sizeof(text))) {
+                if (parse_pattern(text)) {
+                    match_found = false;
+                    search = true;
+                } else {
+                    ui_message("Type hex bytes like 1F 8B,\nor text in quotes.");
+                }
+            }
+        }
+        if ((keys_down & KEY_A) && pattern_len > 0) search = true;
+
+        if (search) {
+            u32 from = match_found ? match_offset + 1 : (u32)top * per_row;
+            match_found = search_from(from);
+            if (match_found) {
+                top = match_offset / per_row;
+                snprintf(status, sizeof(status), "Found at %lX  A:next", (unsigned long)match_offset);
+            } else {
+                snprintf(status, sizeof(status), "Not found");
+            }
+        }
+
+        if (top < 0) top = 0;
+        if (top > max_top) top = max_top;
+
+        swiWaitForVBlank();
+    }
+
+    fclose(file);
+    file = NULL;
+    if (dense) dense_detach();
+}
@@ -0,0 +1,21 @@
+#ifndef HEXVIEW_H
+#define HEXVIEW_H
+
+#include <nds.h>
+
+// Read-only hex view of any file. Only the HEX_PAGE_SIZE pages on screen,
+// one page ahead in the scroll direction and the most recently used ones,
+// as many as the memory profile allows (profile.h), are kept in memory. So
+// large files open at once and the memory used does not depend on the file size.
+
+#define HEX_PAGE_SIZE     4096
+#define HEX_MAX_PATTERN   32      // Max bytes searched for
+
+// Allocate the page cache, at least 3 pages: two can be on screen, plus
+// the prefetched one. False if out of memory.
+bool hexview_init(int pages);
+
+// View filepath, on the bottom screen with the console or in dense mode
+void hexview_run(const char *filepath, bool dense);
+
+#endif // HEXVIEW_H
@@ -0,0 +1,37 @@
+#include <nds.h>
+#include "confedit.h"
+#include "hot.h"
+
+// Nonzero if one of the four bytes of w is zero
+#define HAS_ZERO_BYTE(w)  (((w) - 0x01010101u) & ~(w) & 0x80808080u)
+
+typedef u32 __attribute__((may_alias)) word;   // Lines are char arrays
+
+HOT_CODE void text_insert(char *line, int len, int at, const char *text, int n) {
+    // From the end, the NUL included, so the tail is not overwritten
+    for (int i = len; i >= at; i--) line[i + n] = line[i];
+    for (int i = 0; i < n; i++) line[at + i] = text[i];
+}
+
+HOT_CODE void text_delete(char *line, int len, int from, int to) {
+    for (int i = to; i <= len; i++) line[from + i - to] = line[i];
+}
+
+// Lines are word aligned, only the words up to the NUL are copied
+static inline void copy_line(word *dst, const word *src) {
+    for (int i = 0; i < MAX_LINE_LENGTH / 4; i++) {
+        u32 w = src[i];
+        dst[i] = w;
+        if (HAS_ZERO_BYTE(w)) break;
+    }
+}
+
+HOT_CODE void lines_move(char lines[][MAX_LINE_LENGTH], int dst, int src, int count) {
+    if (dst > src) {
+        for (int i = count - 1; i >= 0; i--)
+            copy_line((word *)lines[dst + i], (const word *)lines[src + i]);
+    } else if (dst < src) {
+        for (int i = 0; i < count; i++)
+            copy_line((word *)lines[dst + i], (const word *)lines[src + i]);
+    }
+}
@@ -0,0 +1,34 @@
+#ifndef HOT_H
+#define HOT_H
+
+#include <nds.h>
+#include "confedit.h"
+
+// The editor's inner loops and the data they walk every frame are kept in
+// the ARM9's tightly coupled memories: ITCM (32KB, code) and DTCM (16KB,
+// data, shared with the stack). Both run at CPU speed without going through
+// the caches. Building with NO_TCM=1 leaves everything in main RAM, so the
+// two builds can be compared with BENCH=1 (see bench.c), and make tcm
+// reports how much of each is used.
+
+#ifdef CONFEDIT_NO_TCM
+#define HOT_CODE
+#define HOT_DATA
+#define HOT_BSS
+#else
+#define HOT_CODE    ITCM_CODE __attribute__((target("arm")))  // 32 bit fetches are free from ITCM
+#define HOT_DATA    DTCM_DATA
+#define HOT_BSS     DTCM_BSS
+#endif
+
+// Insert n bytes of text at position at of line, len being strlen(line).
+// The caller checks that len + n < MAX_LINE_LENGTH.
+void text_insert(char *line, int len, int at, const char *text, int n);
+
+// Remove bytes from..to-1 of line, len being strlen(line)
+void text_delete(char *line, int len, int from, int to);
+
+// Move count lines from src to dst, the ranges may overlap
+void lines_move(char lines[][MAX_LINE_LENGTH], int dst, int src, int count);
+
+#endif // HOT_H
@@ -0,0 +1,123 @@
+#include <nds.h>
+#include "input.h"
+
+static InputEvent queue[INPUT_QUEUE_SIZE];
+static volatile int queue_head;     // Written by the interrupts
+static volatile int queue_tail;     // Written by the main loop
+
+static volatile u32 now_ms;
+static volatile u32 held;
+static volatile bool keyboard_enabled;
+
+static u32 latency_last;
+static u32 latency_max;
+
+// Called from both interrupts. The libnds dispatcher enables interrupts
+// again before calling a handler, so the timer can fire while the VBlank
+// handler is pushing: interrupts stay off while an event is added.
+static void push_event(u8 type, u16 code) {
+    int old_ime = enterCriticalSection();
+    int next = (queue_head + 1) % INPUT_QUEUE_SIZE;
+    if (next != queue_tail) {  // Else full, drop the newest
+        queue[queue_head].type = type;
+        queue[queue_head].code = code;
+        queue[queue_head].time = now_ms;
+        queue_head = next;
+    }
+    leaveCriticalSection(old_ime);
+}
+
+static void input_timer_isr(void) {
+    now_ms++;
+
+    u32 current = keysCurrent() & ~(KEY_TOUCH | KEY_LID);
+    u32 pressed = current & ~held;
+    held = current;
+
+    while (pressed) {
+        u32 bit = pressed & -pressed;
+        push_event(INPUT_KEY_DOWN, bit);
+        pressed &= ~bit;
+    }
+}
+
+static void input_vblank_isr(void) {
+    scanKeys();
+    if (!keyboard_enabled) return;
+
+    int key = keyboardUpdate();
+    if (key > 0) push_event(INPUT_CHAR, key);
+}
+
+void input_init(void) {
+    queue_head = queue_tail = 0;
+    now_ms = 0;
+    held = keysCurrent();
+
+    irqSet(IRQ_VBLANK, input_vblank_isr);
+    timerStart(INPUT_TIMER, ClockDivider_64, TIMER_FREQ_64(INPUT_POLL_HZ), input_timer_isr);
+}
+
+void input_keyboard(bool enable) {
+    if (enable) {
+        keyboardDemoInit();
+        keyboardShow();
+        keyboard_enabled = true;
+    } else {
+        keyboard_enabled = false;
+        keyboardHide();
+    }
+}
+
+bool input_next(InputEvent *event) {
+    if (queue_tail == queue_head) return false;
+
+    *event = queue[queue_tail];
+    queue_tail = (queue_tail + 1) % INPUT_QUEUE_SIZE;
+    return true;
+}
+
+void input_flush(void) {
+    queue_tail = queue_head;
+}
+
+u32 input_keys_down(void) {
+    InputEvent event;
+    u32 keys = 0;
+    while (input_next(&event)) {
+        if (event.type == INPUT_KEY_DOWN) keys |= event.code;
+        input_handled(&event);
+    }
+    return keys;
+}
+
+u32 input_keys_held(void) {
+    return held;
+}
+
+bool input_touch(int *x, int *y) {
+    if (!(keysCurrent() & KEY_TOUCH)) return false;
+
+    touchPosition touch;
+    touchRead(&touch);
+    *x = touch.px;
+    *y = touch.py;
+    return true;
+}
+
+u32 input_now(void) {
+    return now_ms;
+}
+
+void input_handled(const InputEvent *event) {
+    latency_last = now_ms - event->time;
+    if (latency_last > latency_max) latency_max = latency_last;
+}
+
+u32 input_latency_last(void) {
+    return latency_last;
+}
+
+u32 input_latency_max(void) {
+    return latency_max;
+}
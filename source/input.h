@@ -0,0 +1,55 @@
+#ifndef INPUT_H
+#define INPUT_H
+
+#include <nds.h>
+
+// Input is sampled from interrupts and queued, so presses made while a
+// frame runs long are still handled, in order, on the next frame.
+//   Timer 2 (INPUT_POLL_HZ): buttons, edge detected from keysCurrent()
+//   VBlank: scanKeys() and the touch keyboard, when enabled
+// Timers 0 and 1 stay free for cpuStartTiming().
+
+#define INPUT_TIMER       2
+#define INPUT_POLL_HZ     1000
+#define INPUT_QUEUE_SIZE  64
+
+enum {
+    INPUT_KEY_DOWN,     // code is the KEY_* bit pressed
+    INPUT_CHAR          // code is the character typed on the touch keyboard
+};
+
+typedef struct {
+    u8 type;
+    u16 code;
+    u32 time;           // input_now() when the event was sampled
+} InputEvent;
+
+void input_init(void);
+
+// Show the touch keyboard and queue its characters, or stop and hide it
+void input_keyboard(bool enable);
+
+// Oldest queued event, false if the queue is empty
+bool input_next(InputEvent *event);
+
+// Drop every queued event
+void input_flush(void);
+
+// Drain the queue and return all keys pressed since the last call
+u32 input_keys_down(void);
+
+// Keys currently held, as last sampled by the timer
+u32 input_keys_held(void);
+
+// Stylus position, false if the screen is not touched
+bool input_touch(int *x, int *y);
+
+// Milliseconds since input_init()
+u32 input_now(void);
+
+// Record that an event was handled, for the latency statistics
+void input_handled(const InputEvent *event);
+u32 input_latency_last(void);
+u32 input_latency_max(void);
+
+#endif // INPUT_H
@@ -0,0 +1,367 @@
+#include <nds.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "confedit.h"
+#include "input.h"
+#include "journal.h"
+
+// File layout, little endian:
+//   header: "CEJ1", u32 size of the file on disk, u16 path length, path
+//   batch:  u32 length, u32 FNV-1a of the records, records
+//   record: u8 type, u16 line, u16 count or text length, u8 ending, text
+
+#define JOURNAL_MAGIC   "CEJ1"
+#define RECORD_HEADER   6
+
+enum {
+    RECORD_SET = 1,     // Replace the text and ending of a line
+    RECORD_INSERT,      // Insert count empty lines
+    RECORD_REMOVE       // Remove count lines
+};
+
+static FILE *file;
+static int slot = -1;                       // Slot of the active journal, -1 if none
+static bool resume;                         // The journal on the card is continued by the next batch
+static long resume_end;                     // Its valid length, 0 to keep it whole
+static char journal_file[MAX_PATH_LEN];     // File the edits belong to
+static u32 journal_disk_size;               // Size of that file when the journal started
+
+static u8 batch[JOURNAL_BATCH_SIZE];
+static int batch_len;
+static int last_set_offset = -1;    // Last record of the batch if it is a RECORD_SET
+static int last_set_line;
+
+static long valid_end;              // End of the last valid batch found by journal_replay()
+static int valid_slot = -1;         // Slot journal_replay() read
+
+static bool unsynced;               // Batches written but maybe still in the FAT cache
+static u32 first_change;            // input_now() of the oldest unwritten change
+static u32 last_change;
+static u32 last_write;
+
+static u32 fnv1a(const u8 *data, int len) {
+    u32 hash = 2166136261u;
+    for (int i = 0; i < len; i++) {
+        hash ^= data[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static void put_u16(u8 *p, u16 v) {
+    p[0] = v;
+    p[1] = v >> 8;
+}
+
+static void put_u32(u8 *p, u32 v) {
+    put_u16(p, v);
+    put_u16(p + 2, v >> 16);
+}
+
+static u16 get_u16(const u8 *p) {
+    return p[0] | (p[1] << 8);
+}
+
+static u32 get_u32(const u8 *p) {
+    return get_u16(p) | ((u32)get_u16(p + 2) << 16);
+}
+
+static void journal_path(int index, char *out, int size) {
+    snprintf(out, size, JOURNAL_PATH_FORMAT, index);
+}
+
+static void write_header(void) {
+    u8 head[10];
+    int path_len = strlen(journal_file);
+    memcpy(head, JOURNAL_MAGIC, 4);
+    put_u32(head + 4, journal_disk_size);
+    put_u16(head + 8, path_len);
+    fwrite(head, 1, sizeof(head), file);
+    fwrite(journal_file, 1, path_len, file);
+}
+
+// Open the journal left in the slot to add batches after its valid ones, a
+// batch cut short by a power loss is dropped. NULL if there is none.
+static FILE *open_to_append(const char *path) {
+    FILE *f = fopen(path, "r+b");
+    if (!f) return NULL;
+    if (resume_end > 0 && ftruncate(fileno(f), resume_end) != 0) {
+        fclose(f);
+        return NULL;
+    }
+    fseek(f, 0, SEEK_END);
+    return f;
+}
+
+// Make the batches written so far reach the card
+static void sync_journal(void) {
+    if (file && unsynced) fsync(fileno(file));
+    unsynced = false;
+}
+
+// Write the batch. While typing goes on it is left in the FAT cache, as
+// flushing that cache stalls a frame; sync is set once typing pauses.
+static void write_batch(bool sync) {
+    if (slot < 0 || batch_len == 0) return;
+
+    // The journal file is opened, or created, with the first batch
+    if (!file && resume) {
+        char path[MAX_PATH_LEN];
+        journal_path(slot, path, sizeof(path));
+        resume = false;
+        file = open_to_append(path);
+    }
+    if (!file) {
+        char path[MAX_PATH_LEN];
+        journal_path(slot, path, sizeof(path));
+        mkdir("/_nds", 0777);
+        mkdir(CONFEDIT_DIR, 0777);
+        file = fopen(path, "wb");
+        if (!file) {
+            batch_len = 0;
+            last_set_offset = -1;
+            return;
+        }
+        write_header();
+    }
+
+    u8 head[8];
+    put_u32(head, batch_len);
+    put_u32(head + 4, fnv1a(batch, batch_len));
+
+    // One write per batch
+    fwrite(head, 1, sizeof(head), file);
+    fwrite(batch, 1, batch_len, file);
+    fflush(file);
+    unsynced = true;
+    if (sync) sync_journal();
+
+    batch_len = 0;
+    last_set_offset = -1;
+    last_write = input_now();
+}
+
+void journal_open(int index, const char *filepath, const TextFileInfo *info, bool resume_journal) {
+    slot = index;
+    file = NULL;
+    batch_len = 0;
+    last_set_offset = -1;
+    strncpy(journal_file, filepath, sizeof(journal_file) - 1);
+    journal_file[sizeof(journal_file) - 1] = '\0';
+    journal_disk_size = info->disk_size;
+
+    // The card is only touched when there is something to write, so
+    // switching to a buffer costs no I/O
+    resume = resume_journal;
+    resume_end = 0;
+    if (resume && valid_slot == slot) {
+        resume_end = valid_end;
+        valid_slot = -1;
+    }
+}
+
+static u8 *add_record(int type, int line, int count, int eol, int text_len) {
+    if (slot < 0) return NULL;
+    if (batch_len + RECORD_HEADER + text_len > JOURNAL_BATCH_SIZE) write_batch(false);
+
+    u32 now = input_now();
+    if (batch_len == 0) first_change = now;
+    last_change = now;
+
+    u8 *p = batch + batch_len;
+    p[0] = type;
+    put_u16(p + 1, line);
+    put_u16(p + 3, count);
+    p[5] = eol;
+    batch_len += RECORD_HEADER + text_len;
+    return p + RECORD_HEADER;
+}
+
+void journal_set_line(char lines[][MAX_LINE_LENGTH], const TextFileInfo *info, int index) {
+    // Typing on a line only keeps its latest text in the batch. The batch
+    // is not new then, even if that record was all it held: it keeps the
+    // time of its first change so JOURNAL_MAX_DELAY_MS still applies.
+    int rewound = -1;
+    u32 batch_start = first_change;
+    if (last_set_offset >= 0 && last_set_line == index) rewound = batch_len = last_set_offset;
+
+    int len = strlen(lines[index]);
+    u8 *text = add_record(RECORD_SET, index, len, info->line_eol[index], len);
+    if (!text) return;
+
+    memcpy(text, lines[index], len);
+    last_set_offset = text - RECORD_HEADER - batch;
+    if (last_set_offset == rewound) first_change = batch_start;
+    last_set_line = index;
+}
+
+void journal_insert_lines(int index, int count) {
+    add_record(RECORD_INSERT, index, count, 0, 0);
+    last_set_offset = -1;
+}
+
+void journal_remove_lines(int index, int count) {
+    add_record(RECORD_REMOVE, index, count, 0, 0);
+    last_set_offset = -1;
+}
+
+void journal_tick(void) {
+    u32 now = input_now();
+    if (batch_len == 0) {
+        // The last batch was written while typing, it is synced in the pause
+        if (unsynced && now - last_change >= JOURNAL_IDLE_MS) sync_journal();
+        return;
+    }
+
+    bool idle = now - last_change >= JOURNAL_IDLE_MS && now - last_write >= JOURNAL_INTERVAL_MS;
+    if (idle) write_batch(true);
+    else if (now - first_change >= JOURNAL_MAX_DELAY_MS) write_batch(false);
+}
+
+// Close the active journal, deleting it from the card if remove_file is set
+static void end_journal(bool remove_file) {
+    if (!remove_file) sync_journal();
+    unsynced = false;
+    if (file) fclose(file);
+    file = NULL;
+    resume = false;
+    batch_len = 0;
+    last_set_offset = -1;
+    if (remove_file && slot >= 0) journal_discard(slot);
+}
+
+void journal_saved(const TextFileInfo *info) {
+    end_journal(true);
+    journal_disk_size = info->disk_size;
+}
+
+void journal_suspend(void) {
+    write_batch(true);
+    end_journal(false);
+    slot = -1;
+}
+
+void journal_close(void) {
+    end_journal(true);
+    slot = -1;
+}
+
+void journal_discard(int index) {
+    char path[MAX_PATH_LEN];
+    journal_path(index, path, sizeof(path));
+    remove(path);
+    if (valid_slot == index) valid_slot = -1;
+}
+
+bool journal_exists(int index) {
+    char path[MAX_PATH_LEN];
+    struct stat st;
+    journal_path(index, path, sizeof(path));
+    return stat(path, &st) == 0;
+}
+
+// Read the header, returns the path length or -1
+static int read_header(FILE *f, char *path, int size, u32 *disk_size) {
+    u8 head[10];
+    if (fread(head, 1, sizeof(head), f) != sizeof(head) || memcmp(head, JOURNAL_MAGIC, 4) != 0)
+        return -1;
+
+    int path_len = get_u16(head + 8);
+    if (path_len >= size || (int)fread(path, 1, path_len, f) != path_len) return -1;
+    path[path_len] = '\0';
+    *disk_size = get_u32(head + 4);
+    return path_len;
+}
+
+// Next complete batch into the batch buffer, false at the end of the valid part
+static bool read_batch(FILE *f) {
+    u8 head[8];
+    if (fread(head, 1, sizeof(head), f) != sizeof(head)) return false;
+
+    batch_len = get_u32(head);
+    if (batch_len <= 0 || batch_len > JOURNAL_BATCH_SIZE) return false;
+    if ((int)fread(batch, 1, batch_len, f) != batch_len) return false;
+    return fnv1a(batch, batch_len) == get_u32(head + 4);
+}
+
+// Open the journal in slot for reading
+static FILE *open_journal(int index) {
+    char path[MAX_PATH_LEN];
+    journal_path(index, path, sizeof(path));
+    return fopen(path, "rb");
+}
+
+bool journal_pending(int index, char *path, int size) {
+    FILE *f = open_journal(index);
+    if (!f) return false;
+
+    u32 disk_size;
+    bool pending = read_header(f, path, size, &disk_size) >= 0 && read_batch(f);
+    fclose(f);
+    batch_len = 0;
+    return pending;
+}
+
+int journal_slot_of(const char *path) {
+    for (int i = 0; i < JOURNAL_SLOTS; i++) {
+        FILE *f = open_journal(i);
+        if (!f) continue;
+
+        char other[MAX_PATH_LEN];
+        u32 disk_size;
+        bool same = read_header(f, other, sizeof(other), &disk_size) >= 0 && strcmp(other, path) == 0;
+        fclose(f);
+        if (same) return i;
+    }
+    return -1;
+}
+
+bool journal_replay(int index, const char *filepath, char lines[][MAX_LINE_LENGTH], int *total, TextFileInfo *info) {
+    FILE *f = open_journal(index);
+    if (!f) return false;
+
+    char path[MAX_PATH_LEN];
+    u32 disk_size;
+    if (read_header(f, path, sizeof(path), &disk_size) < 0 ||
+        strcmp(path, filepath) != 0 || disk_size != info->disk_size) {
+        fclose(f);
+        return false;
+    }
+
+    int first_line = *total;
+    valid_slot = index;
+    valid_end = ftell(f);
+    while (read_batch(f)) {
+        valid_end = ftell(f);
+        for (int pos = 0; pos + RECORD_HEADER <= batch_len;) {
+            const u8 *p = batch + pos;
+            int line = get_u16(p + 1);
+            int count = get_u16(p + 3);
+            int text_len = (p[0] == RECORD_SET) ? count : 0;
+            pos += RECORD_HEADER + text_len;
+            if (pos > batch_len || line > *total) break;
+            if (line < first_line) first_line = line;
+
+            if (p[0] == RECORD_SET && line < *total && count < MAX_LINE_LENGTH && p[5] <= EOL_CR) {
+                memcpy(lines[line], p + RECORD_HEADER, count);
+                lines[line][count] = '\0';
+                info->line_eol[line] = p[5];
+            } else if (p[0] == RECORD_INSERT && *total + count <= MAX_LINES) {
+                memmove(lines[line + count], lines[line], (*total - line) * MAX_LINE_LENGTH);
+                memmove(&info->line_eol[line + count], &info->line_eol[line], *total - line);
+                *total += count;
+            } else if (p[0] == RECORD_REMOVE && line + count <= *total && count < *total) {
+                memmove(lines[line], lines[line + count], (*total - line - count) * MAX_LINE_LENGTH);
+                memmove(&info->line_eol[line], &info->line_eol[line + count], *total - line - count);
+                *total -= count;
+            }
+        }
+    }
+    fclose(f);
+    batch_len = 0;
+
+    if (first_line < info->dirty_line) info->dirty_line = first_line;
+    return true;
+}
@@ -0,0 +1,66 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <nds.h>
+#include "confedit.h"
+#include "textfile.h"
+
+// Autosave journal. Every change to the buffer is appended to a journal on
+// the card, so edits survive a power loss and can be replayed on the next
+// launch. Changes are collected in RAM and written as one checksummed batch
+// once typing pauses, at most every JOURNAL_INTERVAL_MS, or after
+// JOURNAL_MAX_DELAY_MS of continuous typing. Batches written while typing
+// goes on are only synced to the card in the next pause, a sync stalls a
+// frame. A batch cut short by a power loss fails its checksum and is
+// ignored with everything after it.
+// Each open buffer has its own journal, in the slot of the buffer. Only the
+// active one is written to, the journals of the others wait on the card.
+// A journal file is only created when its first batch is written.
+
+#define JOURNAL_PATH_FORMAT   CONFEDIT_DIR "/journal%d.bin"
+#define JOURNAL_SLOTS         8         // Journals kept at once
+#define JOURNAL_BATCH_SIZE    4096      // Bytes of changes kept in RAM
+#define JOURNAL_IDLE_MS       300       // Pause in typing before writing
+#define JOURNAL_INTERVAL_MS   2000      // Min time between two writes
+#define JOURNAL_MAX_DELAY_MS  10000     // Max age of an unwritten change
+
+// Start journaling the edits of filepath in slot, or continue the journal
+// already in the slot if resume is set (after journal_replay() or
+// journal_suspend()). The card is not touched before the first batch.
+void journal_open(int slot, const char *filepath, const TextFileInfo *info, bool resume);
+
+// Record changes to the buffer, in the order they are made
+void journal_set_line(char lines[][MAX_LINE_LENGTH], const TextFileInfo *info, int index);
+void journal_insert_lines(int index, int count);
+void journal_remove_lines(int index, int count);
+
+// Write the pending changes when it is time to, call once per frame
+void journal_tick(void);
+
+// The file was saved, the journal starts over from it
+void journal_saved(const TextFileInfo *info);
+
+// Another buffer becomes active: write the pending changes and keep the
+// journal on the card
+void journal_suspend(void);
+
+// The file was closed, the journal is deleted
+void journal_close(void);
+
+// Path of the file a previous session left a journal for in slot
+bool journal_pending(int slot, char *path, int size);
+
+// Slot of the journal left for path, or -1
+int journal_slot_of(const char *path);
+
+// A journal file is in slot
+bool journal_exists(int slot);
+
+// Apply the journal in slot to the freshly loaded buffer of filepath.
+// False if there is none, or if the file changed since it was written.
+bool journal_replay(int slot, const char *filepath, char lines[][MAX_LINE_LENGTH], int *total, TextFileInfo *info);
+
+// Forget the journal left by a previous session in slot
+void journal_discard(int slot);
+
+#endif // JOURNAL_H
@@ -3,28 +3,32 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <ctype.h>
 #include <dirent.h>
+#include <time.h>
+#include <sys/stat.h>
 #include "logo.h"
-
-// Constants
-#define SCREEN_LINES      24      // Number of visible lines on screen
-#define TOP_MARGIN 3      // Top margin for header
-#define MAX_VISIBLE_LINES (SCREEN_LINES - TOP_MARGIN)
-
-// Browser
-#define MAX_ENTRIES       512     // Max number of directory entries
-#define MAX_PATH_LEN      256     // Max length for file paths
-
-#define SKIP_LINES        20      // Number of lines to skip on left/right key press
-#define BROWSER_REPEAT_DELAY 15
-#define BROWSER_REPEAT_RATE 3
-
-// Editor
-#define MAX_LINES         1024    // Max lines in a text file
-#define MAX_LINE_LENGTH   256     // Max length of a single line
-
-#define EDITOR_REPEAT_DELAY 20
-#define EDITOR_REPEAT_RATE 4
+#include "confedit.h"
+#include "ui.h"
+#include "grep.h"
+#include "patch.h"
+#include "diff.h"
+#include "textfile.h"
+#include "input.h"
+#include "dense.h"
+#include "complete.h"
+#include "fold.h"
+#include "clip.h"
+#include "journal.h"
+#include "hexview.h"
+#include "backup.h"
+#include "buffer.h"
+#include "minimap.h"
+#include "hot.h"
+#include "bench.h"
+#include "profile.h"
+#include "schema.h"
+#include "format.h"
 
 // Global state variables
 int scroll_offset = 0;            // Current scroll offset in directory listing
@@ -35,13 +39,103 @@ int repeat_direction = 0;         // Direction of repeat: -1 (up), +1 (down), 0
 typedef struct {
     char name[256];               // Entry name
     bool is_dir;                  // True if directory
+    bool has_meta;                // size and mtime fetched
+    u32 size;                     // File size in bytes
+    time_t mtime;                 // Last modification time
 } Entry;
 
-// Directory entries array and count
-Entry entries[MAX_ENTRIES];
+// Directory entries array, its size from the memory profile, and count
+Entry *entries;
+int max_entries;
 int entry_count = 0;
 char current_path[MAX_PATH_LEN] = "/";
 
+bool dense_mode = false;          // 64 column text mode, toggled with Select
+bool show_all_files = false;      // List files the editor does not support too
+bool minimap_mode = false;        // Minimap instead of the keyboard on the bottom screen while editing
+
+// Browser sort order, cycled with X and reversed with L
+enum {
+    SORT_NAME,
+    SORT_EXTENSION,
+    SORT_SIZE,
+    SORT_DATE,
+    SORT_COUNT
+};
+
+static const char *const sort_names[SORT_COUNT] = {
+    "name",
+    "extension",
+    "size",
+    "date",
+};
+
+int sort_key = SORT_NAME;
+bool sort_descending = false;
+
+// Precomputed sort key of one entry
+#define SORT_PREFIX_LEN 8
+typedef struct {
+    u32 num;                      // Size or timestamp
+    char prefix[SORT_PREFIX_LEN]; // Lowercase start of name or extension
+    u16 index;                    // Position in entries before sorting
+    u8 is_dir;
+    u8 pending;                   // Size or date not fetched yet, sorted after the others by name
+} SortKey;
+
+static SortKey *sort_keys;        // One per entry
+static int meta_scan;             // Next entry fetch_metadata() looks at past the visible rows
+
+int sort_entries(int keep);
+
+// Text from (y0, x0) up to (y1, x1), x in bytes
+typedef struct {
+    int y0, x0;
+    int y1, x1;
+} TextRange;
+
+// Editor edit menu (Start)
+enum {
+    EDIT_CUT,
+    EDIT_COPY,
+    EDIT_PASTE,
+    EDIT_DUPLICATE,
+    EDIT_SWITCH,
+    EDIT_CLOSE,
+    EDIT_MINIMAP,
+    EDIT_COUNT
+};
+
+static const char *const edit_actions[EDIT_COUNT] = {
+    "Cut",
+    "Copy",
+    "Paste",
+    "Duplicate line",
+    "Switch to another open file",
+    "Close file, drop its changes",
+    "Minimap / keyboard",
+};
+
+// Browser actions menu (Y)
+enum {
+    ACTION_SEARCH,
+    ACTION_SEARCH_RECURSIVE,
+    ACTION_PATCH,
+    ACTION_HEX_VIEW,
+    ACTION_RESTORE,
+    ACTION_SHOW_ALL,
+    ACTION_COUNT
+};
+
+static const char *const browser_actions[ACTION_COUNT] = {
+    "Search in folder",
+    "Search in subfolders",
+    "Run selected patch script",
+    "Hex view selected file",
+    "Restore a backup of the file",
+    "Show all files / supported only",
+};
+
 // Initialize console on top screen
 void init_top_console(void) {
     videoSetMode(MODE_0_2D);
@@ -67,20 +161,22 @@ void show_logo_on_top_screen() {
     dmaCopy(logoPal, BG_PALETTE, logoPalLen);
 }
 
-bool is_supported_file(const char *filename) {
-    size_t len = strlen(filename);
-    if (len < 5) return false;  // Minimal length for extensions like ".ini"
-
-    const char *ext = strrchr(filename, '.');
-    if (!ext) return false;
+// Allocate the browser listing and the pools of the other modules with the
+// sizes of the detected memory profile, false if out of memory
+bool alloc_pools(void) {
+    const Profile *profile = profile_get();
+    max_entries = profile->max_entries;
+    entries = malloc(max_entries * sizeof(Entry));
+    sort_keys = malloc(max_entries * sizeof(SortKey));
+
+    return entries && sort_keys &&
+           buffer_init(profile->buffer_pool) &&
+           clip_init(profile->clip_pool) &&
+           hexview_init(profile->hex_pages);
+}
 
-    return (
-        strcasecmp(ext, ".ini") == 0 ||
-        strcasecmp(ext, ".cfg") == 0 ||
-        strcasecmp(ext, ".txt") == 0 ||
-        strcasecmp(ext, ".json") == 0 ||
-        strcasecmp(ext, ".xml") == 0
-    );
+bool is_supported_file(const char *filename) {
+    return format_of_name(filename) != NULL;
 }
 
 void read_directory(const char *path) {
@@ -94,39 +190,198 @@ void read_directory(const char *path) {
     struct dirent *pent;
     entry_count = 0;
 
-    while ((pent = readdir(pdir)) != NULL && entry_count < MAX_ENTRIES) {
+    while ((pent = readdir(pdir)) != NULL && entry_count < max_entries) {
         if (strcmp(".", pent->d_name) == 0 || strcmp("..", pent->d_name) == 0)
             continue;
 
         bool is_dir = (pent->d_type == DT_DIR);
+        if (is_dir && strcmp(pent->d_name, BACKUP_DIR_NAME) == 0) continue;
 
-        // Skip unsupported files if not a directory
-        if (!is_dir && !is_supported_file(pent->d_name)) continue;
+        // Skip unsupported files if not a directory, unless all files are shown
+        if (!is_dir && !show_all_files && !is_supported_file(pent->d_name)) continue;
 
         strncpy(entries[entry_count].name, pent->d_name, sizeof(entries[entry_count].name) - 1);
         entries[entry_count].name[sizeof(entries[entry_count].name) - 1] = '\0';
 
         entries[entry_count].is_dir = is_dir;
+        entries[entry_count].has_meta = false;
         entry_count++;
     }
 
     closedir(pdir);
 
-    // Sort entries: directories first, then files alphabetically
-    for (int i = 0; i < entry_count - 1; i++) {
-        for (int j = i + 1; j < entry_count; j++) {
-            if (!entries[i].is_dir && entries[j].is_dir) {
-                Entry temp = entries[i];
-                entries[i] = entries[j];
-                entries[j] = temp;
-            } else if (entries[i].is_dir == entries[j].is_dir &&
-                       strcasecmp(entries[i].name, entries[j].name) > 0) {
-                Entry temp = entries[i];
-                entries[i] = entries[j];
-                entries[j] = temp;
+    sort_entries(-1);
+}
+
+// Full path of the entry at index in the current directory
+void build_entry_path(int index, char *out, int size) {
+    snprintf(out, size, "%s%s%s",
+             current_path,
+             (strcmp(current_path, "/") == 0) ? "" : "/",
+             entries[index].name);
+}
+
+// Read size and date of one entry
+void stat_entry(int index) {
+    char path[MAX_PATH_LEN];
+    struct stat st;
+    build_entry_path(index, path, sizeof(path));
+    if (stat(path, &st) == 0) {
+        entries[index].size = st.st_size;
+        entries[index].mtime = st.st_mtime;
+    } else {
+        entries[index].size = 0;
+        entries[index].mtime = 0;
+    }
+    entries[index].has_meta = true;
+}
+
+// Fetch size and date for the visible rows, then one page ahead in the
+// scroll direction, then when sorting by size or date for the rest of the
+// listing. Stops after META_FRAME_TICKS so scrolling stays smooth, the
+// remaining rows fill in on the next frames. Returns true when the listing
+// has to be sorted again: rows in view got their metadata, or the last
+// missing one was fetched.
+bool fetch_metadata(int scroll_offset, int direction) {
+    int page = MAX_VISIBLE_LINES;
+    int ahead = (direction < 0) ? scroll_offset - page : scroll_offset + page;
+    int ranges[2][2] = {
+        { scroll_offset, scroll_offset + page },
+        { ahead, ahead + page },
+    };
+
+    bool fetched = false;
+    cpuStartTiming(0);
+    for (int r = 0; r < 2; r++) {
+        int start = ranges[r][0] < 0 ? 0 : ranges[r][0];
+        int end = ranges[r][1] > entry_count ? entry_count : ranges[r][1];
+
+        for (int i = start; i < end; i++) {
+            if (entries[i].has_meta) continue;
+            if (cpuGetTiming() > META_FRAME_TICKS) {
+                cpuEndTiming();
+                return fetched;
             }
+
+            stat_entry(i);
+            fetched = true;
+        }
+    }
+
+    bool scanned = false;
+    for (; (sort_key == SORT_SIZE || sort_key == SORT_DATE) && meta_scan < entry_count; meta_scan++) {
+        if (entries[meta_scan].has_meta) continue;
+        if (cpuGetTiming() > META_FRAME_TICKS) break;
+        stat_entry(meta_scan);
+        scanned = true;
+    }
+    cpuEndTiming();
+    return fetched || (scanned && meta_scan == entry_count);
+}
+
+// Entries only hold the folded name prefix and a number for sorting, the
+// full names are compared only when the prefixes are equal
+HOT_CODE static int compare_sort_keys(const void *a, const void *b) {
+    const SortKey *ka = a;
+    const SortKey *kb = b;
+
+    // Directories always first, then the entries whose size or date is known
+    if (ka->is_dir != kb->is_dir) return kb->is_dir - ka->is_dir;
+    if (ka->pending != kb->pending) return ka->pending - kb->pending;
+
+    int diff = 0;
+    if (ka->num != kb->num) diff = (ka->num < kb->num) ? -1 : 1;
+    if (diff == 0) diff = memcmp(ka->prefix, kb->prefix, SORT_PREFIX_LEN);
+    if (diff == 0) diff = strcasecmp(entries[ka->index].name, entries[kb->index].name);
+    return (sort_descending && !ka->pending) ? -diff : diff;
+}
+
+// Sort entries with the current sort_key and order. The filesystem is not
+// read: by size or date, the entries fetch_metadata() has not reached yet
+// go last, by name, and take their place when it sorts again. Returns the
+// new position of the entry at index keep.
+int sort_entries(int keep) {
+    SortKey *keys = sort_keys;
+    bool by_meta = (sort_key == SORT_SIZE || sort_key == SORT_DATE);
+
+    for (int i = 0; i < entry_count; i++) {
+        const char *name = entries[i].name;
+        SortKey *k = &keys[i];
+
+        k->pending = by_meta && !entries[i].has_meta;
+        if (sort_key == SORT_EXTENSION) {
+            const char *dot = strrchr(name, '.');
+            name = (dot && !entries[i].is_dir) ? dot + 1 : "";
+        }
+
+        int j = 0;
+        for (; j < SORT_PREFIX_LEN && name[j]; j++) k->prefix[j] = tolower((unsigned char)name[j]);
+        for (; j < SORT_PREFIX_LEN; j++) k->prefix[j] = 0;
+
+        k->num = k->pending ? 0 :
+                 (sort_key == SORT_SIZE) ? entries[i].size :
+                 (sort_key == SORT_DATE) ? (u32)entries[i].mtime : 0;
+        k->index = i;
+        k->is_dir = entries[i].is_dir;
+    }
+
+    qsort(keys, entry_count, sizeof(SortKey), compare_sort_keys);
+    meta_scan = 0;
+
+    int kept = 0;
+    for (int i = 0; i < entry_count; i++) {
+        if (keys[i].index == keep) kept = i;
+    }
+
+    // Move the entries in place following the permutation cycles, so each
+    // entry is copied once and no second entries array is needed
+    for (int start = 0; start < entry_count; start++) {
+        if (keys[start].index == start) continue;
+
+        Entry temp = entries[start];
+        int j = start;
+        while (keys[j].index != start) {
+            int src = keys[j].index;
+            entries[j] = entries[src];
+            keys[j].index = j;
+            j = src;
         }
+        entries[j] = temp;
+        keys[j].index = j;
+    }
+
+    return kept;
+}
+
+#ifdef CONFEDIT_BENCH
+// Listing for bench_run(), sorted by each key in turn. The names share their
+// first eight characters, so the full names are compared too.
+static u32 bench_sort_listing(void) {
+    entry_count = max_entries;
+    for (int i = 0; i < max_entries; i++) {
+        Entry *e = &entries[i];
+        snprintf(e->name, sizeof(e->name), "settings_%03d.%s", (i * 263) % max_entries, (i % 3) ? "ini" : "json");
+        e->is_dir = (i % 16 == 0);
+        e->has_meta = true;
+        e->size = (i * 2654435761u) % 100000;
+        e->mtime = 1600000000 + (i * 40503) % 1000000;
     }
+
+    cpuStartTiming(0);
+    for (sort_key = 0; sort_key < SORT_COUNT; sort_key++) sort_entries(-1);
+    u32 usec = timerTicks2usec(cpuEndTiming());
+
+    sort_key = SORT_NAME;
+    entry_count = 0;
+    return usec;
+}
+#endif
+
+// Human readable size in at most 4 characters
+void format_size(u32 size, char *out, int out_size) {
+    if (size < 1000) snprintf(out, out_size, "%3luB", (unsigned long)size);
+    else if (size < 1000 * 1024) snprintf(out, out_size, "%3luK", (unsigned long)(size / 1024));
+    else snprintf(out, out_size, "%3luM", (unsigned long)(size / (1024 * 1024)));
 }
 
 void draw_directory(int cursor, int scroll_offset) {
@@ -134,6 +389,7 @@ void draw_directory(int cursor, int scroll_offset) {
 
     // Print header at fixed position (line 0)
     iprintf("\x1b[1;1H%s\n", current_path);
+    iprintf("\x1b[2;1HSort: %s %s", sort_names[sort_key], sort_descending ? "(desc)" : "");
 
     // Calculate visible range based on scroll
     int start = scroll_offset;
@@ -170,9 +426,107 @@ void draw_directory(int cursor, int scroll_offset) {
                 iprintf("%s", entries[i].name);
             }
         }
+
+        // Size column, filled in once the metadata is fetched
+        if (entries[i].has_meta && !entries[i].is_dir) {
+            char size[8];
+            format_size(entries[i].size, size, sizeof(size));
+            iprintf("\x1b[%d;%dH %s", line_num, SCREEN_COLUMNS - 4, size);
+        }
     }
 }
 
+// Dense mode version of draw_directory(), on the bottom screen
+void draw_directory_dense(int cursor, int scroll_offset) {
+    dense_attach(false);
+    dense_clear();
+    dense_print(0, 0, current_path, DENSE_DIM);
+    int sort_col = dense_print(1, 0, "Sort: ", DENSE_DIM);
+    sort_col += dense_print(1, sort_col, sort_names[sort_key], DENSE_DIM);
+    if (sort_descending) dense_print(1, sort_col, " (desc)", DENSE_DIM);
+
+    int start = scroll_offset;
+    int end = (start + MAX_VISIBLE_LINES < entry_count) ? start + MAX_VISIBLE_LINES : entry_count;
+
+    for (int i = start; i < end; i++) {
+        int row = i - start + TOP_MARGIN;
+        u8 attr = (i == cursor) ? DENSE_INVERSE : DENSE_NORMAL;
+        int col = dense_print(row, 0, (i == cursor) ? "> " : "  ", attr);
+
+        if (entries[i].is_dir) col += dense_print(row, col, "[", attr);
+        col += dense_print(row, col, entries[i].name, attr);
+        if (entries[i].is_dir) dense_print(row, col, "]", attr);
+
+        // Size and date columns, filled in once the metadata is fetched
+        if (entries[i].has_meta) {
+            char meta[24] = "    ";
+            struct tm *tm = localtime(&entries[i].mtime);
+            if (!entries[i].is_dir) format_size(entries[i].size, meta, sizeof(meta));
+            meta[4] = '\0';
+            if (tm) strftime(meta + 4, sizeof(meta) - 4, " %Y-%m-%d %H:%M", tm);
+            dense_print(row, DENSE_COLUMNS - strlen(meta) - 1, meta, DENSE_DIM);
+        }
+    }
+
+    dense_flush();
+}
+
+// Pick one of the backups of filepath and put it back, true if restored
+bool restore_backup(const char *filepath) {
+    static Backup backups[BACKUP_GENERATIONS];
+    static char labels[BACKUP_GENERATIONS][SCREEN_COLUMNS];
+    const char *items[BACKUP_GENERATIONS];
+
+    int count = backup_list(filepath, backups, BACKUP_GENERATIONS);
+    if (count == 0) {
+        ui_message("No backups of this file.\nThey are made when it is saved.");
+        return false;
+    }
+
+    for (int i = 0; i < count; i++) {
+        char size[8];
+        backup_label(&backups[i], labels[i], sizeof(labels[i]));
+        format_size(backups[i].size, size, sizeof(size));
+        strncat(labels[i], " ", sizeof(labels[i]) - strlen(labels[i]) - 1);
+        strncat(labels[i], size, sizeof(labels[i]) - strlen(labels[i]) - 1);
+        items[i] = labels[i];
+    }
+
+    int choice = ui_menu("Restore backup (newest first)", items, count);
+    if (choice < 0) return false;
+
+    static const char *const confirm[] = { "Restore, back up the current file", "Cancel" };
+    if (ui_menu(items[choice], confirm, 2) != 0) return false;
+
+    if (!backup_restore(filepath, &backups[choice])) {
+        ui_message("Restore failed.");
+        return false;
+    }
+    ui_message("Backup restored.");
+    return true;
+}
+
+// Files were written, schemas and dictionaries kept in RAM may be stale
+static void forget_card_files(void) {
+    schema_forget_card();
+    complete_forget_dictionaries();
+}
+
+// Open files with unsaved changes were changed on the card
+static void warn_changed_buffers(int count) {
+    if (count == 0) return;
+    char message[128];
+    snprintf(message, sizeof(message), "%d open file%s with unsaved\nchanges %s changed on the card.\nSaving replaces the new version.",
+             count, count > 1 ? "s" : "", count > 1 ? "were" : "was");
+    ui_message(message);
+}
+
+// Give the bottom screen back to the console
+void browser_console(void) {
+    dense_detach();
+    consoleDemoInit();
+}
+
 // Navigate one directory up in current_path
 void go_up_directory() {
     if (strcmp(current_path, "/") == 0) return;
@@ -193,16 +547,6 @@ void go_up_directory() {
     }
 }
 
-void save_file(const char *filepath, char file_lines[][MAX_LINE_LENGTH], int total_lines) {
-    FILE *file = fopen(filepath, "w");
-    if (!file) return;
-
-    for (int i = 0; i < total_lines; i++) {
-        fprintf(file, "%s\n", file_lines[i]);
-    }
-    fclose(file);
-}
-
 // Draw a single line with cursor shown at cursor_x on cursor_y line
 void draw_line_with_cursor(int cursor_x, int cursor_y, int line_index, const char* line) {
 
@@ -216,223 +560,830 @@ void draw_line_with_cursor(int cursor_x, int cursor_y, int line_index, const cha
     }
 }
 
-void view_text_file(const char *filepath) {
-    init_top_console();
+// Dense mode editor view, scrolled horizontally to keep the cursor visible
+void draw_text_dense(const char *filepath, char file_lines[][MAX_LINE_LENGTH], int visible_rows,
+                     int scroll, int cursor_x, int cursor_y, const char *hint, const TextRange *selection) {
+    static u32 draw_us;
+    char status[DENSE_COLUMNS + 1];
+
+    dense_attach(true);
+    dense_clear();
+    dense_print(0, 1, filepath, DENSE_DIM);
+    snprintf(status, sizeof(status), "input latency %lums (max %lums)  draw %luus",
+             (unsigned long)input_latency_last(), (unsigned long)input_latency_max(), (unsigned long)draw_us);
+    dense_print(1, 1, status, DENSE_DIM);
+    dense_print(2, 1, hint, DENSE_DIM);
+
+    int col_offset = (cursor_x >= DENSE_COLUMNS) ? cursor_x - DENSE_COLUMNS + 1 : 0;
+    for (int i = 0; i < MAX_VISIBLE_LINES && scroll + i < visible_rows; i++) {
+        int line_index = fold_row_to_line(scroll + i);
+        const char *line = file_lines[line_index];
+        int len = strlen(line);
+        int col = 0;
+        if (col_offset < len) col = dense_print(i + TOP_MARGIN, 0, line + col_offset, DENSE_NORMAL);
+
+        int hidden = fold_hidden_after(line_index);
+        if (hidden > 0) {
+            char marker[16];
+            snprintf(marker, sizeof(marker), " [+%d]", hidden);
+            col += dense_print(i + TOP_MARGIN, col, marker, DENSE_DIM);
+        }
+        if (schema_status(line_index) != SCHEMA_OK) dense_put(i + TOP_MARGIN, col + 1, '!', DENSE_INVERSE);
 
-    FILE *file = fopen(filepath, "r");
-    if (!file) {
-        consoleClear();
-        iprintf("Failed to open file:\n%s\nPress B to return.", filepath);
-        while (1) {
-            scanKeys();
-            if (keysDown() & KEY_B) break;
-            swiWaitForVBlank();
+        if (selection && line_index >= selection->y0 && line_index <= selection->y1) {
+            int from = (line_index == selection->y0) ? selection->x0 : 0;
+            int to = (line_index == selection->y1) ? selection->x1 : len;
+            for (int x = from; x < to; x++) {
+                if (x >= col_offset) dense_put(i + TOP_MARGIN, x - col_offset, line[x], DENSE_INVERSE);
+            }
         }
+
+        if (line_index == cursor_y) {
+            char c = (cursor_x < len) ? line[cursor_x] : ' ';
+            dense_put(i + TOP_MARGIN, cursor_x - col_offset, c, DENSE_INVERSE);
+        }
+    }
+
+    draw_us = dense_flush();
+}
+
+// Cursor positions around x, stepping over whole UTF-8 characters
+static int cursor_prev(const char *line, int x, bool utf8) {
+    x--;
+    while (utf8 && x > 0 && utf8_continuation(line[x])) x--;
+    return x;
+}
+
+static int cursor_next(const char *line, int x, bool utf8) {
+    x++;
+    while (utf8 && line[x] != '\0' && utf8_continuation(line[x])) x++;
+    return x;
+}
+
+static int cursor_align(const char *line, int x, bool utf8) {
+    while (utf8 && x > 0 && utf8_continuation(line[x])) x--;
+    return x;
+}
+
+// Lines above and below on screen, skipping collapsed regions, -1 at the ends
+static int line_above(int line) {
+    int row = fold_line_to_row(line);
+    return (row > 0) ? fold_row_to_line(row - 1) : -1;
+}
+
+static int line_below(int line) {
+    int row = fold_line_to_row(line);
+    return (row < fold_visible_rows() - 1) ? fold_row_to_line(row + 1) : -1;
+}
+
+// Keys completing the one typed before the cursor, and the typed length
+static int find_suggestions(const char *line, int cursor_x,
+                            char out[][COMPLETE_MAX_KEY + 1], int *prefix_len) {
+    *prefix_len = complete_prefix(line, cursor_x);
+    if (*prefix_len == 0) return 0;
+    return complete_lookup(line + cursor_x - *prefix_len, *prefix_len, out, COMPLETE_SUGGESTIONS);
+}
+
+// Buffer changes are passed on to the fold map, the schema check, the
+// autosave journal and the minimap
+static void line_changed(char lines[][MAX_LINE_LENGTH], const TextFileInfo *info, int index) {
+    fold_update_line(lines, index);
+    schema_update_line(lines, index);
+    journal_set_line(lines, info, index);
+    minimap_line_changed(index);
+}
+
+static void lines_inserted(int index, int count) {
+    fold_insert_lines(index, count);
+    schema_insert_lines(index, count);
+    journal_insert_lines(index, count);
+    minimap_lines_moved(index);
+}
+
+static void lines_removed(int index, int count) {
+    fold_remove_lines(index, count);
+    schema_remove_lines(index, count);
+    journal_remove_lines(index, count);
+    minimap_lines_moved(index);
+}
+
+// Selection between the anchor and the cursor, in text order
+static TextRange ordered_range(int ay, int ax, int by, int bx) {
+    if (ay > by || (ay == by && ax > bx)) return (TextRange){ by, bx, ay, ax };
+    return (TextRange){ ay, ax, by, bx };
+}
+
+// Remove the text from (y0, x0) to (y1, x1), the lines after it move up
+// with a single lines_move(). False if the joined line would be too long.
+static bool delete_range(char lines[][MAX_LINE_LENGTH], int *total, TextFileInfo *info,
+                         int y0, int x0, int y1, int x1) {
+    int tail = strlen(lines[y1]) - x1;
+    if (x0 + tail >= MAX_LINE_LENGTH) return false;
+
+    clip_before_edit(lines, y0, y0);
+    if (y1 > y0) clip_before_remove(lines, y0 + 1, y1 - y0);
+    for (int l = y0; l <= y1; l++) complete_remove_line(lines[l]);
+
+    if (y1 == y0) text_delete(lines[y0], x1 + tail, x0, x1);
+    else memcpy(&lines[y0][x0], &lines[y1][x1], tail + 1);
+    if (y1 > y0) {
+        int moved = *total - y1 - 1;
+        lines_move(lines, y0 + 1, y1 + 1, moved);
+        // The joined line ends like the last removed one did
+        info->line_eol[y0] = info->line_eol[y1];
+        memmove(&info->line_eol[y0 + 1], &info->line_eol[y1 + 1], moved);
+        lines_removed(y0 + 1, y1 - y0);
+        *total -= y1 - y0;
+    }
+
+    complete_add_line(lines[y0]);
+    line_changed(lines, info, y0);
+    if (y0 < info->dirty_line) info->dirty_line = y0;
+    return true;
+}
+
+// Insert the clipboard at the cursor. Lines after the cursor move down once
+// for the whole clipboard, then each pasted line is copied in place.
+// False if the result would not fit in the buffer.
+static bool paste_clip(char lines[][MAX_LINE_LENGTH], int *total, TextFileInfo *info,
+                       int *cursor_y, int *cursor_x) {
+    int n = clip_segments();
+    int y = *cursor_y, x = *cursor_x;
+    if (n == 0) return true;
+    if (*total + n - 1 > MAX_LINES) return false;
+    if (!clip_before_edit(lines, y, y)) return false;
+
+    // Check every resulting line before changing anything
+    int line_len = strlen(lines[y]);
+    for (int i = 0; i < n; i++) {
+        int len;
+        clip_segment(lines, i, &len);
+        if (i == 0) len += x;
+        if (i == n - 1) len += line_len - x;
+        if (len >= MAX_LINE_LENGTH) return false;
+    }
+
+    char tail[MAX_LINE_LENGTH];
+    strcpy(tail, &lines[y][x]);
+    complete_remove_line(lines[y]);
+
+    if (n > 1) {
+        int moved = *total - y - 1;
+        clip_before_insert(lines, y + 1, n - 1);
+        lines_move(lines, y + n, y + 1, moved);
+        // The last pasted line keeps the original ending, the others get the file's usual one
+        memmove(&info->line_eol[y + n], &info->line_eol[y + 1], moved);
+        info->line_eol[y + n - 1] = info->line_eol[y];
+        memset(&info->line_eol[y], info->eol, n - 1);
+        lines_inserted(y + 1, n - 1);
+        *total += n - 1;
+    }
+
+    // Referenced segments are outside y..y + n - 1, at their shifted lines
+    for (int i = 0; i < n; i++) {
+        int len;
+        const char *text = clip_segment(lines, i, &len);
+        char *dst = (i == 0) ? &lines[y][x] : lines[y + i];
+        memcpy(dst, text, len);
+        dst[len] = '\0';
+    }
+
+    *cursor_y = y + n - 1;
+    *cursor_x = strlen(lines[*cursor_y]);
+    strcat(lines[*cursor_y], tail);
+
+    for (int l = y; l <= *cursor_y; l++) {
+        complete_add_line(lines[l]);
+        line_changed(lines, info, l);
+    }
+    fold_reveal(*cursor_y);
+    if (y < info->dirty_line) info->dirty_line = y;
+    return true;
+}
+
+// Copy line y below itself
+static bool duplicate_line(char lines[][MAX_LINE_LENGTH], int *total, TextFileInfo *info, int y) {
+    if (*total >= MAX_LINES) return false;
+
+    clip_before_insert(lines, y + 1, 1);
+    lines_move(lines, y + 2, y + 1, *total - y - 1);
+    memmove(&info->line_eol[y + 2], &info->line_eol[y + 1], *total - y - 1);
+    strcpy(lines[y + 1], lines[y]);
+    info->line_eol[y + 1] = info->line_eol[y];
+    if (info->line_eol[y] == EOL_NONE) info->line_eol[y] = info->eol;
+    lines_inserted(y + 1, 1);
+    (*total)++;
+
+    complete_add_line(lines[y + 1]);
+    line_changed(lines, info, y);
+    line_changed(lines, info, y + 1);
+    if (y < info->dirty_line) info->dirty_line = y;
+    return true;
+}
+
+// Both files use the same completion dictionary
+static bool same_extension(const char *a, const char *b) {
+    const char *ext_a = strrchr(a, '.');
+    const char *ext_b = strrchr(b, '.');
+    if (!ext_a || !ext_b) return !ext_a && !ext_b;
+    return strcasecmp(ext_a, ext_b) == 0;
+}
+
+// Some line of the file has an ending. New lines of a file without any get
+// the ending of its format.
+static bool has_eol(const TextFileInfo *info, int total) {
+    for (int l = 0; l < total; l++) {
+        if (info->line_eol[l] != EOL_NONE) return true;
+    }
+    return false;
+}
+
+// Make buffer index active: unpack it from the pool, or read it from the
+// card with the edits its journal holds. previous is the path of the buffer
+// active before, whose keys left the trie if it has the same extension.
+// Returns the line count, or -1 if the file can't be read.
+static int enter_buffer(int index, char lines[][MAX_LINE_LENGTH], TextFileInfo *info, const char *previous) {
+    Buffer *buf = buffer_get(index);
+    int total;
+    bool resume = true;
+
+    if (buffer_activate(index, lines)) {
+        *info = buf->info;
+        total = buf->total_lines;
+    } else {
+        total = load_text_file(buf->path, lines, info);
+        if (total < 0) return -1;
+        // Edits of a session that ended without closing the file
+        resume = journal_replay(index, buf->path, lines, &total, info);
+
+        // The file may have changed since the buffer was dropped
+        if (buf->cursor_y >= total) buf->cursor_y = total - 1;
+        int len = strlen(lines[buf->cursor_y]);
+        if (buf->cursor_x > len) buf->cursor_x = len;
+        buf->cursor_x = cursor_align(lines[buf->cursor_y], buf->cursor_x, info->utf8);
+    }
+    journal_open(index, buf->path, info, resume);
+
+    const Format *format = format_of_file(buf->path, lines, total);
+    if (!has_eol(info, total)) info->eol = format->eol;
+
+    complete_set_format(format);
+    if (!previous || !same_extension(previous, buf->path)) complete_reset(buf->path);
+    for (int l = 0; l < total; l++) complete_add_line(lines[l]);
+    fold_reset(format->outline, lines, total);
+    schema_reset(format->schema ? buf->path : NULL, lines, total);
+    minimap_set_format(format);
+    return total;
+}
+
+// Pack the active buffer into the pool with its cursor and scroll. next is
+// the path of the buffer activated after it, if any. False, with the buffer
+// still active, if there is no room for its unsaved changes.
+static bool leave_buffer(int index, char lines[][MAX_LINE_LENGTH], int total, const TextFileInfo *info,
+                         int cursor_x, int cursor_y, int scroll, const char *next) {
+    Buffer *buf = buffer_get(index);
+    buf->total_lines = total;
+    buf->info = *info;
+    buf->cursor_x = cursor_x;
+    buf->cursor_y = cursor_y;
+    buf->scroll = scroll;
+
+    // The clipboard may point into the text, which is about to be replaced
+    clip_detach(lines);
+    if (!buffer_store(lines)) return false;
+    journal_suspend();
+
+    // The next buffer keeps the dictionary, only the keys of this one go
+    if (next && same_extension(buf->path, next)) {
+        for (int l = 0; l < total; l++) complete_remove_line(lines[l]);
+    }
+    return true;
+}
+
+// Let the user pick another open buffer, -1 if cancelled
+static int pick_buffer(int current) {
+    static char labels[BUFFER_MAX][SCREEN_COLUMNS];
+    const char *items[BUFFER_MAX];
+    int indices[BUFFER_MAX];
+    int count = 0;
+
+    for (int i = 0; i < BUFFER_MAX; i++) {
+        Buffer *buf = buffer_get(i);
+        if (!buf->open || i == current) continue;
+        const char *name = strrchr(buf->path, '/');
+        snprintf(labels[count], sizeof(labels[count]), "%c %s", buffer_dirty(buf) ? '*' : ' ',
+                 name ? name + 1 : buf->path);
+        items[count] = labels[count];
+        indices[count] = i;
+        count++;
+    }
+    if (count == 0) {
+        ui_message("No other file is open.");
+        return -1;
+    }
+
+    int choice = ui_menu("Open files (* unsaved)", items, count);
+    return (choice < 0) ? -1 : indices[choice];
+}
+
+void view_text_file(const char *path, int start_line) {
+    int current = buffer_find(path);
+    if (current < 0) current = buffer_open(path);
+    if (current < 0) {
+        ui_message("Too many files with unsaved\nchanges are open, save or\nclose one of them first.");
         return;
     }
 
-    static char file_lines[MAX_LINES][MAX_LINE_LENGTH];
-    int total_lines = 0;
+    init_top_console();
 
-    while (fgets(file_lines[total_lines], MAX_LINE_LENGTH, file) && total_lines < MAX_LINES) {
-        size_t len = strlen(file_lines[total_lines]);
-        if (len > 0 && (file_lines[total_lines][len - 1] == '\n' || file_lines[total_lines][len - 1] == '\r'))
-            file_lines[total_lines][len - 1] = '\0';
-        total_lines++;
+    static char file_lines[MAX_LINES][MAX_LINE_LENGTH] ALIGN(4);   // Word aligned for lines_move()
+    static TextFileInfo info;
+    int total_lines = enter_buffer(current, file_lines, &info, NULL);
+    if (total_lines < 0) {
+        buffer_close(current);
+        consoleClear();
+        iprintf("Failed to open file:\n%s\nPress B to return.", path);
+        ui_wait_key(KEY_B);
+        return;
     }
-    fclose(file);
 
     videoSetModeSub(MODE_0_2D);
     vramSetBankC(VRAM_C_SUB_BG);
     consoleInit(NULL, 0, BgType_Text4bpp, BgSize_T_256x256, 31, 0, true, true);
 
-    keyboardDemoInit();
-    keyboardShow();
-
-    int cursor_x = 0, cursor_y = 0, scroll = 0;
+    input_flush();
+    if (minimap_mode) {
+        minimap_attach();
+    } else {
+        input_keyboard(true);
+    }
+    minimap_set_pattern(grep_pattern());
+
+    char suggestions[COMPLETE_SUGGESTIONS][COMPLETE_MAX_KEY + 1];
+    int suggest_count = 0, suggest_selected = 0, prefix_len = 0;
+
+    // Selection from the anchor to the cursor, started with L
+    bool sel_active = false;
+    int sel_y = 0, sel_x = 0;
+
+    // Reopened buffers keep their cursor, unless a line is asked for
+    const char *filepath = buffer_get(current)->path;
+    int cursor_x = buffer_get(current)->cursor_x;
+    int cursor_y = buffer_get(current)->cursor_y;
+    int scroll = buffer_get(current)->scroll;
+    if (start_line >= 0) {
+        cursor_y = (start_line < total_lines) ? start_line : total_lines - 1;
+        cursor_x = 0;
+    }
     int repeat_direction = 0;  // 1=UP, 2=DOWN, 3=LEFT, 4=RIGHT, 0=none
     int repeat_counter = 0;
 
      
     while (1) {
-        consoleClear();
+        // scroll counts screen rows, collapsed regions take one row
+        int cursor_row = fold_line_to_row(cursor_y);
+        int visible_rows = fold_visible_rows();
+        if (cursor_row < scroll)
+            scroll = cursor_row;
+        if (cursor_row >= scroll + MAX_VISIBLE_LINES)
+            scroll = cursor_row - MAX_VISIBLE_LINES + 1;
+
+        // Suggestion strip, X picks a suggestion and R inserts it
+        char hint[DENSE_COLUMNS + 1] = "";
+        suggest_count = find_suggestions(file_lines[cursor_y], cursor_x, suggestions, &prefix_len);
+        if (suggest_selected >= suggest_count) suggest_selected = 0;
+        TextRange selection = ordered_range(sel_y, sel_x, cursor_y, cursor_x);
+        if (sel_active) {
+            snprintf(hint, sizeof(hint), "Selected %d lines, Start: edit", selection.y1 - selection.y0 + 1);
+        } else if (suggest_count > 0) {
+            int pos = snprintf(hint, sizeof(hint), "R:");
+            for (int i = 0; i < suggest_count && pos < (int)sizeof(hint); i++) {
+                pos += snprintf(hint + pos, sizeof(hint) - pos, (i == suggest_selected) ? "[%s]" : " %s ", suggestions[i]);
+            }
+        }
 
-        iprintf("\x1b[1;1H %s", filepath); // draw header at line 0
+        // Lines failing the schema are marked with '!', the cursor line's problem is shown in the strip
+        schema_flush(file_lines);
+        if (hint[0] == '\0') schema_message(file_lines, cursor_y, hint, sizeof(hint));
 
+        if (dense_mode) {
+            draw_text_dense(filepath, file_lines, visible_rows, scroll, cursor_x, cursor_y, hint,
+                            sel_active ? &selection : NULL);
+        } else {
+            consoleClear();
 
-        if (cursor_y < scroll)
-            scroll = cursor_y;
-        if (cursor_y >= scroll + MAX_VISIBLE_LINES)
-            scroll = cursor_y - MAX_VISIBLE_LINES + 1;
+            iprintf("\x1b[1;1H %s", filepath); // draw header at line 0
+            iprintf("\x1b[2;1H input latency %lums (max %lums)", (unsigned long)input_latency_last(), (unsigned long)input_latency_max());
+            iprintf("\x1b[3;1H%.*s", SCREEN_COLUMNS, hint);
 
-for (int i = 0; i < MAX_VISIBLE_LINES; i++) {
-    int line_index = scroll + i;
-    if (line_index >= total_lines) break;
-    const char *line = file_lines[line_index];
+            for (int i = 0; i < MAX_VISIBLE_LINES; i++) {
+                if (scroll + i >= visible_rows) break;
+                int line_index = fold_row_to_line(scroll + i);
+                const char *line = file_lines[line_index];
 
-    // Move to the correct screen line (with offset)
-    iprintf("\x1b[%d;1H", i + TOP_MARGIN + 1); // ANSI is 1-indexed
+                // Move to the correct screen line (with offset)
+                iprintf("\x1b[%d;1H", i + TOP_MARGIN + 1); // ANSI is 1-indexed
 
-    if (line_index == cursor_y) {
-        for (int c = 0; c < cursor_x && line[c] != '\0'; c++)
-            iprintf("%c", line[c]);
-        iprintf("_");
-        iprintf("%s", &line[cursor_x]);
-    } else {
-        iprintf("%s", line);
-    }
-}
-
-
-        int key = keyboardUpdate();
-        if (key > 0) {
-            char *line = file_lines[cursor_y];
-            int len = strlen(line);
-
-            if (key == 8) { // Backspace
-                if (cursor_x > 0) {
-                    memmove(&line[cursor_x - 1], &line[cursor_x], len - cursor_x + 1);
-                    cursor_x--;
-                } else if (cursor_y > 0) {
-                    int prev_len = strlen(file_lines[cursor_y - 1]);
-                    int curr_len = strlen(file_lines[cursor_y]);
-                    if (prev_len + curr_len < MAX_LINE_LENGTH) {
-                        strcat(file_lines[cursor_y - 1], file_lines[cursor_y]);
-                        for (int l = cursor_y; l < total_lines - 1; l++)
-                            strcpy(file_lines[l], file_lines[l + 1]);
-                        total_lines--;
-                        cursor_y--;
-                        cursor_x = prev_len;
+                if (line_index == cursor_y) {
+                    for (int c = 0; c < cursor_x && line[c] != '\0'; c++)
+                        iprintf("%c", line[c]);
+                    iprintf("_");
+                    iprintf("%s", &line[cursor_x]);
+                } else {
+                    iprintf("%s", line);
+                }
+
+                int hidden = fold_hidden_after(line_index);
+                if (hidden > 0) iprintf(" [+%d]", hidden);
+                if (schema_status(line_index) != SCHEMA_OK) iprintf(" !");
+            }
+        }
+
+        // Only the rows that changed are redrawn
+        if (minimap_shown()) {
+            int last_row = scroll + MAX_VISIBLE_LINES - 1;
+            if (last_row >= visible_rows) last_row = visible_rows - 1;
+            minimap_set_view(fold_row_to_line(scroll), fold_row_to_line(last_row), cursor_y);
+            minimap_flush(file_lines, total_lines);
+        }
+
+        InputEvent event;
+        bool have_event;
+        bool close_file = false;
+        bool discard_file = false;
+        int next_buffer = -1;
+        do {
+            have_event = input_next(&event);
+            if (have_event) input_handled(&event);
+
+            int key = (have_event && event.type == INPUT_CHAR) ? event.code : 0;
+            if (key > 0) {
+                char *line = file_lines[cursor_y];
+                int len = strlen(line);
+                int edited_line = (key == 8 && cursor_x == 0) ? cursor_y - 1 : cursor_y;
+                if (edited_line >= 0 && edited_line < cursor_y) fold_reveal(edited_line);
+                if ((key == 8 || key == 13 || (key >= 32 && key <= 126)) && edited_line >= 0 && edited_line < info.dirty_line)
+                    info.dirty_line = edited_line;
+
+                // The keys of the edited lines leave the trie now and come back
+                // once edited, lines first_edit..cursor_y after the edit
+                int first_edit = (edited_line >= 0) ? edited_line : cursor_y;
+                for (int l = first_edit; l <= cursor_y; l++) complete_remove_line(file_lines[l]);
+                clip_before_edit(file_lines, first_edit, cursor_y);
+                sel_active = false;
+
+                if (key == 8) { // Backspace
+                    if (cursor_x > 0) {
+                        int start = cursor_prev(line, cursor_x, info.utf8);
+                        text_delete(line, len, start, cursor_x);
+                        cursor_x = start;
+                    } else if (cursor_y > 0) {
+                        int prev_len = strlen(file_lines[cursor_y - 1]);
+                        int curr_len = strlen(file_lines[cursor_y]);
+                        if (prev_len + curr_len < MAX_LINE_LENGTH) {
+                            clip_before_remove(file_lines, cursor_y, 1);
+                            strcat(file_lines[cursor_y - 1], file_lines[cursor_y]);
+                            lines_move(file_lines, cursor_y, cursor_y + 1, total_lines - cursor_y - 1);
+                            // The joined line ends like the second one did
+                            memmove(&info.line_eol[cursor_y - 1], &info.line_eol[cursor_y], total_lines - cursor_y);
+                            lines_removed(cursor_y, 1);
+                            total_lines--;
+                            cursor_y--;
+                            cursor_x = prev_len;
+                        }
+                    }
+                } else if (key == 13) { // Enter
+                    if (total_lines < MAX_LINES) {
+                        char tail[MAX_LINE_LENGTH] = {0};
+                        strcpy(tail, &line[cursor_x]);
+                        line[cursor_x] = '\0';
+
+                        clip_before_insert(file_lines, cursor_y + 1, 1);
+                        lines_move(file_lines, cursor_y + 2, cursor_y + 1, total_lines - cursor_y - 1);
+
+                        strcpy(file_lines[cursor_y + 1], tail);
+                        // The tail keeps the original ending, the split line gets the file's usual one
+                        memmove(&info.line_eol[cursor_y + 1], &info.line_eol[cursor_y], total_lines - cursor_y);
+                        info.line_eol[cursor_y] = info.eol;
+                        lines_inserted(cursor_y + 1, 1);
+                        total_lines++;
+                        cursor_y++;
+                        cursor_x = 0;
+                    }
+                } else if (key >= 32 && key <= 126) { // Printable chars
+                    if (len < MAX_LINE_LENGTH - 1) {
+                        char c = (char)key;
+                        text_insert(line, len, cursor_x, &c, 1);
+                        cursor_x++;
                     }
                 }
-            } else if (key == 13) { // Enter
-                if (total_lines < MAX_LINES) {
-                    char tail[MAX_LINE_LENGTH] = {0};
-                    strcpy(tail, &line[cursor_x]);
-                    line[cursor_x] = '\0';
-
-                    for (int l = total_lines; l > cursor_y + 1; l--)
-                        strcpy(file_lines[l], file_lines[l - 1]);
-
-                    strcpy(file_lines[cursor_y + 1], tail);
-                    total_lines++;
-                    cursor_y++;
-                    cursor_x = 0;
+
+                for (int l = first_edit; l <= cursor_y; l++) {
+                    complete_add_line(file_lines[l]);
+                    line_changed(file_lines, &info, l);
                 }
-            } else if (key >= 32 && key <= 126) { // Printable chars
-                if (len < MAX_LINE_LENGTH - 1) {
-                    memmove(&line[cursor_x + 1], &line[cursor_x], len - cursor_x + 1);
-                    line[cursor_x] = (char)key;
-                    cursor_x++;
+                fold_reveal(cursor_y);
+            }
+
+            // Queued presses are handled one at a time, held keys repeat once per frame
+            int keys_down = (have_event && event.type == INPUT_KEY_DOWN) ? event.code : 0;
+            int keys_held = have_event ? 0 : input_keys_held();
+
+            // Touching the minimap moves the cursor to the line, dragging moves through the file
+            int touch_x, touch_y;
+            if (!have_event && minimap_shown() && input_touch(&touch_x, &touch_y)) {
+                int line = minimap_line_at(touch_x, touch_y, total_lines);
+                if (line >= 0) {
+                    fold_reveal(line);
+                    cursor_y = line;
+                    cursor_x = 0;
+                    sel_active = false;
                 }
             }
-        }
 
-        scanKeys();
-        int keys_down = keysDown();
-        int keys_held = keysHeld();
+            // Moving while L is held extends the selection from where L was pressed
+            if (keys_down & KEY_L) {
+                sel_active = true;
+                sel_y = cursor_y;
+                sel_x = cursor_x;
+            } else if (((keys_down | keys_held) & (KEY_UP | KEY_DOWN | KEY_LEFT | KEY_RIGHT)) &&
+                       !(input_keys_held() & KEY_L)) {
+                sel_active = false;
+            }
 
-        if ((keys_down & KEY_UP) || (keys_held & KEY_UP && repeat_direction == 1)) {
-            if (keys_down & KEY_UP) {
-                if (cursor_y > 0) {
-                    cursor_y--;
-                    int line_len = strlen(file_lines[cursor_y]);
-                    if (cursor_x > line_len) cursor_x = line_len;
+            if ((keys_down & KEY_UP) || (keys_held & KEY_UP && repeat_direction == 1)) {
+                if (keys_down & KEY_UP) {
+                    if (line_above(cursor_y) >= 0) {
+                        cursor_y = line_above(cursor_y);
+                        int line_len = strlen(file_lines[cursor_y]);
+                        if (cursor_x > line_len) cursor_x = line_len;
+                        cursor_x = cursor_align(file_lines[cursor_y], cursor_x, info.utf8);
+                    }
+                    repeat_direction = 1;
+                    repeat_counter = 0;
+                } else {
+                    repeat_counter++;
+                    if (repeat_counter >= EDITOR_REPEAT_DELAY && (repeat_counter - EDITOR_REPEAT_DELAY) % EDITOR_REPEAT_RATE == 0) {
+                        if (line_above(cursor_y) >= 0) {
+                            cursor_y = line_above(cursor_y);
+                            int line_len = strlen(file_lines[cursor_y]);
+                            if (cursor_x > line_len) cursor_x = line_len;
+                            cursor_x = cursor_align(file_lines[cursor_y], cursor_x, info.utf8);
+                        }
+                    }
                 }
-                repeat_direction = 1;
-                repeat_counter = 0;
-            } else {
-                repeat_counter++;
-                if (repeat_counter >= EDITOR_REPEAT_DELAY && (repeat_counter - EDITOR_REPEAT_DELAY) % EDITOR_REPEAT_RATE == 0) {
-                    if (cursor_y > 0) {
-                        cursor_y--;
+            } else if ((keys_down & KEY_DOWN) || (keys_held & KEY_DOWN && repeat_direction == 2)) {
+                if (keys_down & KEY_DOWN) {
+                    if (line_below(cursor_y) >= 0) {
+                        cursor_y = line_below(cursor_y);
                         int line_len = strlen(file_lines[cursor_y]);
                         if (cursor_x > line_len) cursor_x = line_len;
+                        cursor_x = cursor_align(file_lines[cursor_y], cursor_x, info.utf8);
+                    }
+                    repeat_direction = 2;
+                    repeat_counter = 0;
+                } else {
+                    repeat_counter++;
+                    if (repeat_counter >= EDITOR_REPEAT_DELAY && (repeat_counter - EDITOR_REPEAT_DELAY) % EDITOR_REPEAT_RATE == 0) {
+                        if (line_below(cursor_y) >= 0) {
+                            cursor_y = line_below(cursor_y);
+                            int line_len = strlen(file_lines[cursor_y]);
+                            if (cursor_x > line_len) cursor_x = line_len;
+                            cursor_x = cursor_align(file_lines[cursor_y], cursor_x, info.utf8);
+                        }
+                    }
+                }
+            } else if ((keys_down & KEY_LEFT) || (keys_held & KEY_LEFT && repeat_direction == 3)) {
+                if (keys_down & KEY_LEFT) {
+                    if (cursor_x > 0) cursor_x = cursor_prev(file_lines[cursor_y], cursor_x, info.utf8);
+                    else if (line_above(cursor_y) >= 0) {
+                        cursor_y = line_above(cursor_y);
+                        cursor_x = strlen(file_lines[cursor_y]);
+                    }
+                    repeat_direction = 3;
+                    repeat_counter = 0;
+                } else {
+                    repeat_counter++;
+                    if (repeat_counter >= EDITOR_REPEAT_DELAY && (repeat_counter - EDITOR_REPEAT_DELAY) % EDITOR_REPEAT_RATE == 0) {
+                        if (cursor_x > 0) cursor_x = cursor_prev(file_lines[cursor_y], cursor_x, info.utf8);
+                        else if (line_above(cursor_y) >= 0) {
+                            cursor_y = line_above(cursor_y);
+                            cursor_x = strlen(file_lines[cursor_y]);
+                        }
                     }
                 }
+            } else if ((keys_down & KEY_RIGHT) || (keys_held & KEY_RIGHT && repeat_direction == 4)) {
+                if (keys_down & KEY_RIGHT) {
+                    int line_len = strlen(file_lines[cursor_y]);
+                    if (cursor_x < line_len) cursor_x = cursor_next(file_lines[cursor_y], cursor_x, info.utf8);
+                    else if (line_below(cursor_y) >= 0) {
+                        cursor_y = line_below(cursor_y);
+                        cursor_x = 0;
+                    }
+                    repeat_direction = 4;
+                    repeat_counter = 0;
+                } else {
+                    repeat_counter++;
+                    if (repeat_counter >= EDITOR_REPEAT_DELAY && (repeat_counter - EDITOR_REPEAT_DELAY) % EDITOR_REPEAT_RATE == 0) {
+                        int line_len = strlen(file_lines[cursor_y]);
+                        if (cursor_x < line_len) cursor_x = cursor_next(file_lines[cursor_y], cursor_x, info.utf8);
+                        else if (line_below(cursor_y) >= 0) {
+                            cursor_y = line_below(cursor_y);
+                            cursor_x = 0;
+                        }
+                    }
+                }
+            } else {
+                repeat_direction = 0;
+                repeat_counter = 0;
             }
-        } else if ((keys_down & KEY_DOWN) || (keys_held & KEY_DOWN && repeat_direction == 2)) {
-            if (keys_down & KEY_DOWN) {
-                if (cursor_y < total_lines - 1) {
-                    cursor_y++;
+
+            if (keys_down & KEY_X) suggest_selected++;
+
+            // Fold or unfold the region around the cursor, which moves to its
+            // first line when it gets hidden
+            if (keys_down & KEY_Y) {
+                if (fold_toggle(cursor_y) >= 0) {
+                    cursor_y = fold_row_to_line(fold_line_to_row(cursor_y));
                     int line_len = strlen(file_lines[cursor_y]);
                     if (cursor_x > line_len) cursor_x = line_len;
+                    cursor_x = cursor_align(file_lines[cursor_y], cursor_x, info.utf8);
                 }
-                repeat_direction = 2;
-                repeat_counter = 0;
-            } else {
-                repeat_counter++;
-                if (repeat_counter >= EDITOR_REPEAT_DELAY && (repeat_counter - EDITOR_REPEAT_DELAY) % EDITOR_REPEAT_RATE == 0) {
-                    if (cursor_y < total_lines - 1) {
-                        cursor_y++;
-                        int line_len = strlen(file_lines[cursor_y]);
-                        if (cursor_x > line_len) cursor_x = line_len;
+            }
+
+            if (keys_down & KEY_R) {
+                char *line = file_lines[cursor_y];
+                suggest_count = find_suggestions(line, cursor_x, suggestions, &prefix_len);
+                if (suggest_selected >= suggest_count) suggest_selected = 0;
+
+                if (suggest_count > 0) {
+                    const char *rest = suggestions[suggest_selected] + prefix_len;
+                    int len = strlen(line);
+                    int rest_len = strlen(rest);
+                    if (len + rest_len < MAX_LINE_LENGTH) {
+                        if (cursor_y < info.dirty_line) info.dirty_line = cursor_y;
+                        clip_before_edit(file_lines, cursor_y, cursor_y);
+                        complete_remove_line(line);
+                        text_insert(line, len, cursor_x, rest, rest_len);
+                        cursor_x += rest_len;
+                        complete_add_line(line);
+                        line_changed(file_lines, &info, cursor_y);
                     }
                 }
+                suggest_selected = 0;
             }
-        } else if ((keys_down & KEY_LEFT) || (keys_held & KEY_LEFT && repeat_direction == 3)) {
-            if (keys_down & KEY_LEFT) {
-                if (cursor_x > 0) cursor_x--;
-                else if (cursor_y > 0) {
-                    cursor_y--;
-                    cursor_x = strlen(file_lines[cursor_y]);
+
+            if (keys_down & KEY_SELECT) {
+                dense_mode = !dense_mode;
+                if (!dense_mode) {
+                    dense_detach();
+                    init_top_console();
                 }
-                repeat_direction = 3;
-                repeat_counter = 0;
-            } else {
-                repeat_counter++;
-                if (repeat_counter >= EDITOR_REPEAT_DELAY && (repeat_counter - EDITOR_REPEAT_DELAY) % EDITOR_REPEAT_RATE == 0) {
-                    if (cursor_x > 0) cursor_x--;
-                    else if (cursor_y > 0) {
-                        cursor_y--;
-                        cursor_x = strlen(file_lines[cursor_y]);
+            }
+
+            // Dialogs use the console
+            if ((keys_down & (KEY_A | KEY_B | KEY_START)) && dense_mode) {
+                dense_detach();
+                init_top_console();
+            }
+
+            if ((keys_down & KEY_A) && info.binary) {
+                ui_message("File contains NUL bytes,\nit can't be saved.");
+            } else if ((keys_down & KEY_A) && info.truncated) {
+                char message[96];
+                snprintf(message, sizeof(message), "File has more than %d lines,\nonly the first ones are loaded:\nit can't be saved.", MAX_LINES);
+                ui_message(message);
+            } else if (keys_down & KEY_A) {
+                int result = diff_preview(filepath, file_lines, total_lines, &info);
+                if (result != DIFF_CANCEL) {
+                    consoleClear();
+                    if (result == DIFF_SAVE) {
+                        int written = save_file(filepath, file_lines, total_lines, &info);
+                        if (written >= 0) {
+                            journal_saved(&info);
+                            forget_card_files();
+                            iprintf("File saved! (%d bytes written)\n", written);
+                        } else {
+                            iprintf("Save failed!\n");
+                        }
+                    } else {
+                        info.dirty_line = total_lines;
+                        journal_saved(&info);
+                        iprintf("No changes, file not written.\n");
                     }
+                    iprintf("Press B to return to text editor");
+                    ui_wait_key(KEY_B);
+                    consoleClear();
                 }
             }
-        } else if ((keys_down & KEY_RIGHT) || (keys_held & KEY_RIGHT && repeat_direction == 4)) {
-            if (keys_down & KEY_RIGHT) {
-                int line_len = strlen(file_lines[cursor_y]);
-                if (cursor_x < line_len) cursor_x++;
-                else if (cursor_y < total_lines - 1) {
-                    cursor_y++;
-                    cursor_x = 0;
+
+            // Edit menu, on the selection or else the cursor line
+            if (keys_down & KEY_START) {
+                TextRange range = ordered_range(sel_y, sel_x, cursor_y, cursor_x);
+                if (!sel_active && cursor_y < total_lines - 1) {
+                    range = (TextRange){ cursor_y, 0, cursor_y + 1, 0 };
+                } else if (!sel_active) {
+                    range = (TextRange){ cursor_y, 0, cursor_y, strlen(file_lines[cursor_y]) };
                 }
-                repeat_direction = 4;
-                repeat_counter = 0;
-            } else {
-                repeat_counter++;
-                if (repeat_counter >= EDITOR_REPEAT_DELAY && (repeat_counter - EDITOR_REPEAT_DELAY) % EDITOR_REPEAT_RATE == 0) {
-                    int line_len = strlen(file_lines[cursor_y]);
-                    if (cursor_x < line_len) cursor_x++;
-                    else if (cursor_y < total_lines - 1) {
-                        cursor_y++;
-                        cursor_x = 0;
-                    }
+
+                bool done = true;
+                switch (ui_menu("Edit", edit_actions, EDIT_COUNT)) {
+                    case EDIT_CUT:
+                        clip_copy(range.y0, range.x0, range.y1, range.x1);
+                        done = delete_range(file_lines, &total_lines, &info, range.y0, range.x0, range.y1, range.x1);
+                        if (done) {
+                            cursor_y = range.y0;
+                            cursor_x = range.x0;
+                            fold_reveal(cursor_y);
+                        }
+                        break;
+                    case EDIT_COPY:
+                        clip_copy(range.y0, range.x0, range.y1, range.x1);
+                        break;
+                    case EDIT_PASTE:
+                        done = paste_clip(file_lines, &total_lines, &info, &cursor_y, &cursor_x);
+                        break;
+                    case EDIT_DUPLICATE:
+                        done = duplicate_line(file_lines, &total_lines, &info, cursor_y);
+                        break;
+                    case EDIT_SWITCH:
+                        next_buffer = pick_buffer(current);
+                        break;
+                    case EDIT_CLOSE:
+                        if (info.dirty_line < total_lines) {
+                            static const char *const drop[] = { "Close, drop the changes", "Cancel" };
+                            if (ui_menu("Drop unsaved changes?", drop, 2) != 0) break;
+                        }
+                        discard_file = true;
+                        break;
+                    case EDIT_MINIMAP:
+                        minimap_mode = !minimap_mode;
+                        if (minimap_mode) {
+                            input_keyboard(false);
+                            minimap_attach();
+                        } else {
+                            minimap_detach();
+                            input_keyboard(true);
+                        }
+                        break;
                 }
+                if (!done) ui_message("Not enough room,\nthe text was not changed.");
+                sel_active = false;
             }
-        } else {
-            repeat_direction = 0;
-            repeat_counter = 0;
-        }
 
-        if (keys_down & KEY_A) {
-            save_file(filepath, file_lines, total_lines);
-            consoleClear();
-            iprintf("File saved!\nPress B to return to text editor");
-            while (1) {
-                scanKeys();
-                if (keysDown() & KEY_B) break;
-                swiWaitForVBlank();
+            // Closing the file drops its unsaved edits on purpose
+            if (discard_file) {
+                journal_close();
+                clip_detach(file_lines);   // The clipboard outlives the buffer
+                buffer_close(current);
+                close_file = true;
             }
-            consoleClear();
+
+            // The buffer stays open, with its changes, to come back to it later
+            if (!close_file && ((keys_down & KEY_B) || next_buffer >= 0)) {
+                const char *next = (next_buffer >= 0) ? buffer_get(next_buffer)->path : NULL;
+                if (leave_buffer(current, file_lines, total_lines, &info, cursor_x, cursor_y, scroll, next)) {
+                    close_file = true;
+                } else {
+                    ui_message("Not enough memory to keep\nthe changes of this file.\nSave it or close other files.");
+                    next_buffer = -1;
+                }
+            }
+        } while (have_event && !close_file);
+
+        // Switching only copies the text in RAM, within the frame
+        if (next_buffer >= 0) {
+            const char *previous = filepath;
+            int total = enter_buffer(next_buffer, file_lines, &info, previous);
+            if (total < 0) {
+                // Its file is gone from the card, go back to the buffer left
+                // as if coming from the failed one
+                buffer_close(next_buffer);
+                ui_message("Failed to open file.");
+                previous = buffer_get(next_buffer)->path;
+                next_buffer = current;
+                total = enter_buffer(current, file_lines, &info, previous);
+            }
+            current = next_buffer;
+            total_lines = total;
+            filepath = buffer_get(current)->path;
+            cursor_x = buffer_get(current)->cursor_x;
+            cursor_y = buffer_get(current)->cursor_y;
+            scroll = buffer_get(current)->scroll;
+            sel_active = false;
+            suggest_selected = 0;
+            continue;
         }
 
-        if (keys_down & KEY_B) break;
+        if (close_file) break;
 
+        journal_tick();
         swiWaitForVBlank();
     }
 
-    keyboardHide();
+    input_keyboard(false);
+    minimap_detach();
+    dense_detach();
     show_logo_on_top_screen();
 }
 
@@ -441,20 +1392,54 @@ int main(int argc, char **argv) {
 
     consoleDemoInit();
 
+    profile_init();
+    if (!alloc_pools()) {
+        iprintf("Out of memory: terminating\n");
+        while (1)
+        swiWaitForVBlank();
+    }
+
     if (!fatInitDefault()) {
         iprintf("fatInitDefault fail: terminating\n");
         while (1)
         swiWaitForVBlank();
     }
+    format_init();
+
+    input_init();
+
+#ifdef CONFEDIT_BENCH
+    bench_run(bench_sort_listing);
+    show_logo_on_top_screen();
+#endif
+
+    // Edits left by a session that did not end, e.g. on a power loss
+    char journal_file[MAX_PATH_LEN];
+    for (int slot = 0; slot < JOURNAL_SLOTS; slot++) {
+        if (!journal_pending(slot, journal_file, sizeof(journal_file))) continue;
+
+        static const char *const recover_actions[] = { "Recover unsaved edits", "Discard them" };
+        int choice = ui_menu(journal_file, recover_actions, 2);
+        if (choice == 0) {
+            view_text_file(journal_file, -1);
+            browser_console();
+        } else if (choice == 1) {
+            journal_discard(slot);
+        }
+    }
 
     read_directory(current_path);
 
     int cursor = 0;
+    bool running = true;
     int scroll_offset = 0;
 
     int repeat_counter = 0;
     int repeat_direction = 0;  // -1 = up, 1 = down, 0 = none, -2 = left skip, 2 = right skip
 
+    int last_scroll = 0;
+    int scroll_direction = 1;  // Direction metadata is prefetched in
+
     // Clamp scroll_offset to valid range
     void clamp_scroll_offset() {
         if (scroll_offset < 0) scroll_offset = 0;
@@ -463,135 +1448,222 @@ int main(int argc, char **argv) {
         if (scroll_offset > max_scroll) scroll_offset = max_scroll;
     }
 
+    // Re-sort the listing, the cursor stays on the same entry
+    void resort_listing() {
+        cursor = sort_entries(cursor);
+        if (cursor < scroll_offset) scroll_offset = cursor;
+        if (cursor >= scroll_offset + MAX_VISIBLE_LINES) scroll_offset = cursor - MAX_VISIBLE_LINES + 1;
+        clamp_scroll_offset();
+    }
+
     while (1) {
-        scanKeys();
-        int keys_down = keysDown();
-        int keys_held = keysHeld();
-
-        // Handle UP key with repeat
-        if ((keys_down & KEY_UP) || (keys_held & KEY_UP && repeat_direction == -1)) {
-            if (keys_down & KEY_UP) {
-                cursor = (cursor > 0) ? cursor - 1 : 0;
-                if (cursor < scroll_offset) scroll_offset--;
-                repeat_direction = -1;
-                repeat_counter = 0;
-            } else if (keys_held & KEY_UP) {
-                repeat_counter++;
-                if (repeat_counter >= BROWSER_REPEAT_DELAY) {
-                    if ((repeat_counter - BROWSER_REPEAT_DELAY) % BROWSER_REPEAT_RATE == 0) {
-                        cursor = (cursor > 0) ? cursor - 1 : 0;
-                        if (cursor < scroll_offset) scroll_offset--;
+        InputEvent event;
+        bool have_event;
+        do {
+            have_event = input_next(&event);
+            if (have_event) input_handled(&event);
+
+            // Queued presses are handled one at a time, held keys repeat once per frame
+            int keys_down = (have_event && event.type == INPUT_KEY_DOWN) ? event.code : 0;
+            int keys_held = have_event ? 0 : input_keys_held();
+
+            // Handle UP key with repeat
+            if ((keys_down & KEY_UP) || (keys_held & KEY_UP && repeat_direction == -1)) {
+                if (keys_down & KEY_UP) {
+                    cursor = (cursor > 0) ? cursor - 1 : 0;
+                    if (cursor < scroll_offset) scroll_offset--;
+                    repeat_direction = -1;
+                    repeat_counter = 0;
+                } else if (keys_held & KEY_UP) {
+                    repeat_counter++;
+                    if (repeat_counter >= BROWSER_REPEAT_DELAY) {
+                        if ((repeat_counter - BROWSER_REPEAT_DELAY) % BROWSER_REPEAT_RATE == 0) {
+                            cursor = (cursor > 0) ? cursor - 1 : 0;
+                            if (cursor < scroll_offset) scroll_offset--;
+                        }
                     }
                 }
             }
-        }
-        // Handle DOWN key with repeat
-        else if ((keys_down & KEY_DOWN) || (keys_held & KEY_DOWN && repeat_direction == 1)) {
-            if (keys_down & KEY_DOWN) {
-                cursor = (cursor < entry_count - 1) ? cursor + 1 : entry_count - 1;
-                if (cursor >= scroll_offset + (SCREEN_LINES - 3)) scroll_offset++;
-                repeat_direction = 1;
-                repeat_counter = 0;
-            } else if (keys_held & KEY_DOWN) {
-                repeat_counter++;
-                if (repeat_counter >= BROWSER_REPEAT_DELAY) {
-                    if ((repeat_counter - BROWSER_REPEAT_DELAY) % BROWSER_REPEAT_RATE == 0) {
-                        cursor = (cursor < entry_count - 1) ? cursor + 1 : entry_count - 1;
-                        if (cursor >= scroll_offset + (SCREEN_LINES - 3)) scroll_offset++;
+            // Handle DOWN key with repeat
+            else if ((keys_down & KEY_DOWN) || (keys_held & KEY_DOWN && repeat_direction == 1)) {
+                if (keys_down & KEY_DOWN) {
+                    cursor = (cursor < entry_count - 1) ? cursor + 1 : entry_count - 1;
+                    if (cursor >= scroll_offset + (SCREEN_LINES - 3)) scroll_offset++;
+                    repeat_direction = 1;
+                    repeat_counter = 0;
+                } else if (keys_held & KEY_DOWN) {
+                    repeat_counter++;
+                    if (repeat_counter >= BROWSER_REPEAT_DELAY) {
+                        if ((repeat_counter - BROWSER_REPEAT_DELAY) % BROWSER_REPEAT_RATE == 0) {
+                            cursor = (cursor < entry_count - 1) ? cursor + 1 : entry_count - 1;
+                            if (cursor >= scroll_offset + (SCREEN_LINES - 3)) scroll_offset++;
+                        }
                     }
                 }
             }
-        }
-        // Handle LEFT key with repeat (skip up)
-        else if ((keys_down & KEY_LEFT) || (keys_held & KEY_LEFT && repeat_direction == -2)) {
-            if (keys_down & KEY_LEFT) {
-                cursor -= SKIP_LINES;
-                if (cursor < 0) cursor = 0;
-                if (cursor < scroll_offset) scroll_offset = cursor;
-                repeat_direction = -2;
-                repeat_counter = 0;
-            } else if (keys_held & KEY_LEFT) {
-                repeat_counter++;
-                if (repeat_counter >= BROWSER_REPEAT_DELAY) {
-                    if ((repeat_counter - BROWSER_REPEAT_DELAY) % BROWSER_REPEAT_RATE == 0) {
-                        cursor -= SKIP_LINES;
-                        if (cursor < 0) cursor = 0;
-                        if (cursor < scroll_offset) scroll_offset = cursor;
+            // Handle LEFT key with repeat (skip up)
+            else if ((keys_down & KEY_LEFT) || (keys_held & KEY_LEFT && repeat_direction == -2)) {
+                if (keys_down & KEY_LEFT) {
+                    cursor -= SKIP_LINES;
+                    if (cursor < 0) cursor = 0;
+                    if (cursor < scroll_offset) scroll_offset = cursor;
+                    repeat_direction = -2;
+                    repeat_counter = 0;
+                } else if (keys_held & KEY_LEFT) {
+                    repeat_counter++;
+                    if (repeat_counter >= BROWSER_REPEAT_DELAY) {
+                        if ((repeat_counter - BROWSER_REPEAT_DELAY) % BROWSER_REPEAT_RATE == 0) {
+                            cursor -= SKIP_LINES;
+                            if (cursor < 0) cursor = 0;
+                            if (cursor < scroll_offset) scroll_offset = cursor;
+                        }
                     }
                 }
             }
-        }
-        // Handle RIGHT key with repeat (skip down)
-        else if ((keys_down & KEY_RIGHT) || (keys_held & KEY_RIGHT && repeat_direction == 2)) {
-            if (keys_down & KEY_RIGHT) {
-                cursor += SKIP_LINES;
-                if (cursor >= entry_count) cursor = entry_count - 1;
-                if (cursor >= scroll_offset + (SCREEN_LINES - 3)) scroll_offset = cursor - (SCREEN_LINES - 3) + 1;
-                repeat_direction = 2;
-                repeat_counter = 0;
-            } else if (keys_held & KEY_RIGHT) {
-                repeat_counter++;
-                if (repeat_counter >= BROWSER_REPEAT_DELAY) {
-                    if ((repeat_counter - BROWSER_REPEAT_DELAY) % BROWSER_REPEAT_RATE == 0) {
-                        cursor += SKIP_LINES;
-                        if (cursor >= entry_count) cursor = entry_count - 1;
-                        if (cursor >= scroll_offset + (SCREEN_LINES - 3)) scroll_offset = cursor - (SCREEN_LINES - 3) + 1;
+            // Handle RIGHT key with repeat (skip down)
+            else if ((keys_down & KEY_RIGHT) || (keys_held & KEY_RIGHT && repeat_direction == 2)) {
+                if (keys_down & KEY_RIGHT) {
+                    cursor += SKIP_LINES;
+                    if (cursor >= entry_count) cursor = entry_count - 1;
+                    if (cursor >= scroll_offset + (SCREEN_LINES - 3)) scroll_offset = cursor - (SCREEN_LINES - 3) + 1;
+                    repeat_direction = 2;
+                    repeat_counter = 0;
+                } else if (keys_held & KEY_RIGHT) {
+                    repeat_counter++;
+                    if (repeat_counter >= BROWSER_REPEAT_DELAY) {
+                        if ((repeat_counter - BROWSER_REPEAT_DELAY) % BROWSER_REPEAT_RATE == 0) {
+                            cursor += SKIP_LINES;
+                            if (cursor >= entry_count) cursor = entry_count - 1;
+                            if (cursor >= scroll_offset + (SCREEN_LINES - 3)) scroll_offset = cursor - (SCREEN_LINES - 3) + 1;
+                        }
                     }
                 }
             }
-        }
-        else {
-            // No up/down/left/right key held, reset repeat state
-            repeat_direction = 0;
-            repeat_counter = 0;
-        }
+            else {
+                // No up/down/left/right key held, reset repeat state
+                repeat_direction = 0;
+                repeat_counter = 0;
+            }
 
-        // Clamp scroll_offset after any movement
-        clamp_scroll_offset();
+            // Clamp scroll_offset after any movement
+            clamp_scroll_offset();
 
-        if (keys_down & KEY_START) {
-            break;
-        }
+            if (keys_down & KEY_START) {
+                running = false;
+            }
 
-        if (keys_down & KEY_A) {
-            if (entries[cursor].is_dir) {
-                char new_path[MAX_PATH_LEN];
-                if (strcmp(current_path, "/") == 0) {
-                    snprintf(new_path, MAX_PATH_LEN, "/%s", entries[cursor].name);
+            if (keys_down & KEY_SELECT) {
+                dense_mode = !dense_mode;
+                browser_console();
+            }
+
+            if (keys_down & (KEY_X | KEY_L)) {
+                if (keys_down & KEY_X) sort_key = (sort_key + 1) % SORT_COUNT;
+                if (keys_down & KEY_L) sort_descending = !sort_descending;
+                resort_listing();
+            }
+
+            // Submenus and the editor use the console
+            if ((keys_down & (KEY_A | KEY_Y)) && dense_mode) {
+                browser_console();
+            }
+
+            if (keys_down & KEY_A) {
+                if (entries[cursor].is_dir) {
+                    char new_path[MAX_PATH_LEN];
+                    if (strcmp(current_path, "/") == 0) {
+                        snprintf(new_path, MAX_PATH_LEN, "/%s", entries[cursor].name);
+                    } else {
+                        snprintf(new_path, MAX_PATH_LEN, "%s/%s", current_path, entries[cursor].name);
+                    }
+                    strncpy(current_path, new_path, MAX_PATH_LEN - 1);
+                    current_path[MAX_PATH_LEN - 1] = '\0';
+                    read_directory(current_path);
+                    cursor = 0;
+                    scroll_offset = 0;
+                    draw_directory(cursor, scroll_offset);
                 } else {
-                    snprintf(new_path, MAX_PATH_LEN, "%s/%s", current_path, entries[cursor].name);
+                    const char *filename = entries[cursor].name;
+                    char filepath[MAX_PATH_LEN];
+                    build_entry_path(cursor, filepath, sizeof(filepath));
+                    if (is_supported_file(filename)) {
+                        view_text_file(filepath, -1);
+                    } else {
+                        hexview_run(filepath, dense_mode);
+                    }
+                    browser_console();
+                    draw_directory(cursor, scroll_offset);
+                }
+            }
+
+            if (keys_down & KEY_Y) {
+                switch (ui_menu(current_path, browser_actions, ACTION_COUNT)) {
+                    case ACTION_SEARCH:
+                        grep_run(current_path, false);
+                        break;
+                    case ACTION_SEARCH_RECURSIVE:
+                        grep_run(current_path, true);
+                        break;
+                    case ACTION_PATCH:
+                        if (entry_count > 0 && !entries[cursor].is_dir) {
+                            char script[MAX_PATH_LEN];
+                            build_entry_path(cursor, script, sizeof(script));
+                            patch_run(script);
+                            forget_card_files();
+                            warn_changed_buffers(buffer_drop_clean());
+                        }
+                        break;
+                    case ACTION_HEX_VIEW:
+                        if (entry_count > 0 && !entries[cursor].is_dir) {
+                            char filepath[MAX_PATH_LEN];
+                            build_entry_path(cursor, filepath, sizeof(filepath));
+                            hexview_run(filepath, dense_mode);
+                        }
+                        break;
+                    case ACTION_RESTORE:
+                        if (entry_count > 0 && !entries[cursor].is_dir) {
+                            char filepath[MAX_PATH_LEN];
+                            build_entry_path(cursor, filepath, sizeof(filepath));
+                            if (restore_backup(filepath)) {
+                                forget_card_files();
+                                warn_changed_buffers(buffer_drop_clean());
+                                read_directory(current_path);
+                            }
+                        }
+                        break;
+                    case ACTION_SHOW_ALL:
+                        show_all_files = !show_all_files;
+                        read_directory(current_path);
+                        cursor = 0;
+                        scroll_offset = 0;
+                        break;
                 }
-                strncpy(current_path, new_path, MAX_PATH_LEN - 1);
-                current_path[MAX_PATH_LEN - 1] = '\0';
+                browser_console();
+            }
+
+            if (keys_down & KEY_B) {
+                go_up_directory();
                 read_directory(current_path);
                 cursor = 0;
                 scroll_offset = 0;
-                draw_directory(cursor, scroll_offset);
-            } else {
-                const char *filename = entries[cursor].name;
-                if (is_supported_file(filename)) {
-                    char filepath[MAX_PATH_LEN];
-                    snprintf(filepath, sizeof(filepath), "%s%s%s",
-                             current_path,
-                             (strcmp(current_path, "/") == 0) ? "" : "/",
-                             filename);
-                    view_text_file(filepath);
-                    consoleDemoInit();
-                    draw_directory(cursor, scroll_offset);
-                }
             }
-        }
+        } while (have_event && running);
 
-        if (keys_down & KEY_B) {
-            go_up_directory();
-            read_directory(current_path);
-            cursor = 0;
-            scroll_offset = 0;
-        }
+        if (!running) break;
 
-        consoleClear();
+        if (scroll_offset != last_scroll) {
+            scroll_direction = (scroll_offset > last_scroll) ? 1 : -1;
+            last_scroll = scroll_offset;
+        }
+        if (fetch_metadata(scroll_offset, scroll_direction) && (sort_key == SORT_SIZE || sort_key == SORT_DATE))
+            resort_listing();
 
-draw_directory(cursor, scroll_offset);
+        if (dense_mode) {
+            draw_directory_dense(cursor, scroll_offset);
+        } else {
+            consoleClear();
+            draw_directory(cursor, scroll_offset);
+        }
 
 
         swiWaitForVBlank();
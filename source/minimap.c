@@ -0,0 +1,214 @@
+#include <nds.h>
+#include <string.h>
+#include "confedit.h"
+#include "format.h"
+#include "minimap.h"
+
+#define MINIMAP_MAP_BASE  4       // Same as the dense layer, never on the bottom screen while editing
+#define MINIMAP_PALETTE   224     // First of the palette entries used, below the dense layer's
+#define MINIMAP_COLUMNS   ((MAX_LINES + MINIMAP_COLUMN_LINES - 1) / MINIMAP_COLUMN_LINES)
+
+// Palette entries: backgrounds, then a full and a half density shade per class
+enum {
+    COLOR_BACKGROUND,
+    COLOR_VIEW,         // Background of the lines on screen
+    COLOR_CURSOR,       // Background of the cursor line
+    COLOR_HIT,          // Search mark
+    COLOR_CLASSES
+};
+
+enum {
+    CLASS_KEY,
+    CLASS_VALUE,
+    CLASS_COMMENT,
+    CLASS_SECTION,
+    CLASS_COUNT
+};
+
+static const u16 minimap_colors[COLOR_CLASSES + 2 * CLASS_COUNT] = {
+    RGB15(2, 2, 4),
+    RGB15(6, 6, 11),
+    RGB15(10, 10, 18),
+    RGB15(31, 6, 6),
+    RGB15(26, 26, 28), RGB15(15, 15, 17),  // Key
+    RGB15(10, 22, 12), RGB15(6, 13, 7),    // Value
+    RGB15(11, 11, 11), RGB15(7, 7, 7),     // Comment
+    RGB15(31, 24, 6), RGB15(19, 14, 4),    // Section
+};
+
+static u16 *gfx;
+static bool shown;
+static const Format *format;
+
+static u32 dirty[(MAX_LINES + 31) / 32];
+static int drawn_total;     // Rows drawn at the last flush
+static int moved_from = MAX_LINES;  // First row shifted by inserted or removed lines
+static int view_first, view_last = -1, view_cursor = -1;
+static char pattern[MAX_LINE_LENGTH];
+
+static void mark(int line) {
+    if (line >= 0 && line < MAX_LINES) dirty[line / 32] |= 1u << (line % 32);
+}
+
+static void mark_range(int first, int last) {
+    for (int line = first; line <= last; line++) mark(line);
+}
+
+void minimap_reset(void) {
+    memset(dirty, 0xFF, sizeof(dirty));
+    drawn_total = MAX_LINES;
+}
+
+void minimap_set_format(const Format *f) {
+    format = f;
+    minimap_reset();
+}
+
+void minimap_attach(void) {
+    videoSetModeSub(MODE_5_2D);
+    vramSetBankC(VRAM_C_SUB_BG);
+    int bg = bgInitSub(2, BgType_Bmp8, BgSize_B8_256x256, MINIMAP_MAP_BASE, 0);
+    for (int i = 0; i < COLOR_CLASSES + 2 * CLASS_COUNT; i++)
+        BG_PALETTE_SUB[MINIMAP_PALETTE + i] = minimap_colors[i];
+
+    gfx = bgGetGfxPtr(bg);
+    dmaFillWords((MINIMAP_PALETTE + COLOR_BACKGROUND) * 0x01010101u, gfx, 256 * 192);
+    shown = true;
+    minimap_reset();
+}
+
+void minimap_detach(void) {
+    if (!shown) return;
+    shown = false;
+    videoSetModeSub(MODE_0_2D);
+}
+
+bool minimap_shown(void) {
+    return shown;
+}
+
+void minimap_line_changed(int index) {
+    mark(index);
+}
+
+void minimap_lines_moved(int index) {
+    if (index < moved_from) moved_from = index;
+}
+
+void minimap_set_view(int first, int last, int cursor) {
+    if (first == view_first && last == view_last && cursor == view_cursor) return;
+
+    // Only the rows of the old and new view change, a screen of each
+    mark_range(view_first, view_last);
+    mark_range(first, last);
+    mark(view_cursor);
+    view_first = first;
+    view_last = last;
+    view_cursor = cursor;
+}
+
+void minimap_set_pattern(const char *text) {
+    if (strcmp(text, pattern) == 0) return;
+    strncpy(pattern, text, sizeof(pattern) - 1);
+    pattern[sizeof(pattern) - 1] = '\0';
+    minimap_reset();
+}
+
+// Class of every character of a line: comments and sections are whole
+// lines, XML tags and what comes before the first separator are keys
+static void classify(const char *text, int len, u8 *classes) {
+    int i = 0;
+    while (text[i] == ' ' || text[i] == '\t') i++;
+
+    int whole = -1;
+    if ((text[i] && strchr(format->comments, text[i])) || (text[i] == '/' && text[i + 1] == '/') ||
+        strncmp(text + i, "<!--", 4) == 0)
+        whole = CLASS_COMMENT;
+    else if (text[i] == '[' && format->outline == OUTLINE_SECTIONS)
+        whole = CLASS_SECTION;
+    if (whole >= 0) {
+        memset(classes, whole, len);
+        return;
+    }
+
+    bool in_tag = false, in_value = false;
+    for (i = 0; i < len; i++) {
+        char c = text[i];
+        if (c == '<') in_tag = true;
+        classes[i] = (in_tag || !in_value) ? CLASS_KEY : CLASS_VALUE;
+        if (c == '>') {
+            in_tag = false;
+            in_value = true;
+        } else if (!in_tag && c && strchr(format->separators, c)) {
+            in_value = true;
+        }
+    }
+}
+
+static void draw_row(int line, const char *text) {
+    u8 pixels[MINIMAP_COLUMN_WIDTH];
+    u8 background = COLOR_BACKGROUND;
+    if (line == view_cursor) background = COLOR_CURSOR;
+    else if (line >= view_first && line <= view_last) background = COLOR_VIEW;
+    memset(pixels, MINIMAP_PALETTE + background, MINIMAP_TEXT_WIDTH);
+    memset(pixels + MINIMAP_TEXT_WIDTH, MINIMAP_PALETTE + COLOR_BACKGROUND, MINIMAP_COLUMN_WIDTH - MINIMAP_TEXT_WIDTH);
+
+    if (text) {
+        u8 classes[MAX_LINE_LENGTH];
+        int len = strlen(text);
+        if (len > 2 * MINIMAP_TEXT_WIDTH) len = 2 * MINIMAP_TEXT_WIDTH;
+        classify(text, len, classes);
+
+        for (int x = 0; x < MINIMAP_TEXT_WIDTH && 2 * x < len; x++) {
+            int first = 2 * x;
+            bool a = text[first] != ' ' && text[first] != '\t';
+            bool b = first + 1 < len && text[first + 1] != ' ' && text[first + 1] != '\t';
+            if (!a && !b) continue;
+            int cls = classes[a ? first : first + 1];
+            pixels[x] = MINIMAP_PALETTE + COLOR_CLASSES + 2 * cls + (a && b ? 0 : 1);
+        }
+
+        if (pattern[0] && strstr(text, pattern)) {
+            pixels[MINIMAP_TEXT_WIDTH + 1] = MINIMAP_PALETTE + COLOR_HIT;
+            pixels[MINIMAP_TEXT_WIDTH + 2] = MINIMAP_PALETTE + COLOR_HIT;
+        }
+    }
+
+    // VRAM takes 16 bit writes, columns start on even pixels
+    int x0 = (line / MINIMAP_COLUMN_LINES) * MINIMAP_COLUMN_WIDTH;
+    int y = line % MINIMAP_COLUMN_LINES;
+    u16 *dst = gfx + (y * 256 + x0) / 2;
+    for (int i = 0; i < MINIMAP_COLUMN_WIDTH / 2; i++)
+        dst[i] = pixels[2 * i] | (pixels[2 * i + 1] << 8);
+}
+
+u32 minimap_flush(char lines[][MAX_LINE_LENGTH], int total) {
+    if (!shown) return 0;
+
+    // Rows below inserted or removed lines moved, down to the end of the
+    // longer of the old and new buffer, so rows past a shortened one are cleared
+    int end = (total > drawn_total) ? total : drawn_total;
+    if (moved_from < end) mark_range(moved_from, end - 1);
+    if (total < drawn_total) mark_range(total, drawn_total - 1);
+    moved_from = MAX_LINES;
+    drawn_total = total;
+
+    cpuStartTiming(0);
+    for (int w = 0; w < (MAX_LINES + 31) / 32; w++) {
+        while (dirty[w]) {
+            int bit = __builtin_ctz(dirty[w]);
+            dirty[w] &= dirty[w] - 1;
+            int line = w * 32 + bit;
+            draw_row(line, (line < total) ? lines[line] : NULL);
+        }
+    }
+    return timerTicks2usec(cpuEndTiming());
+}
+
+int minimap_line_at(int x, int y, int total) {
+    if (x < 0 || y < 0 || y >= MINIMAP_COLUMN_LINES) return -1;
+    int column = x / MINIMAP_COLUMN_WIDTH;
+    if (column >= MINIMAP_COLUMNS) return -1;
+    int line = column * MINIMAP_COLUMN_LINES + y;
+    return (line < total) ? line : -1;
+}
@@ -0,0 +1,49 @@
+#ifndef MINIMAP_H
+#define MINIMAP_H
+
+#include <nds.h>
+#include "confedit.h"
+#include "format.h"
+
+// Minimap of the whole buffer on the bottom screen, in place of the touch
+// keyboard. Each line is one pixel row, two characters per pixel, colored
+// by what the characters are (key, value, comment, section). Lines wrap into
+// columns of MINIMAP_COLUMN_LINES rows. The rows on screen in the editor are
+// lighter, and the lines holding the last search pattern get a red mark.
+// Only the rows marked dirty are redrawn by minimap_flush().
+
+#define MINIMAP_COLUMN_LINES  192     // Pixel rows, one line each
+#define MINIMAP_COLUMN_WIDTH  42      // 38 pixels of text, then the search mark
+#define MINIMAP_TEXT_WIDTH    38
+
+// Show the minimap on the bottom screen, every row is redrawn at the next flush
+void minimap_attach(void);
+
+// Give the bottom screen back to the keyboard
+void minimap_detach(void);
+
+bool minimap_shown(void);
+
+// Another buffer is shown, redraw everything
+void minimap_reset(void);
+
+// Format the lines are colored by, redraws everything. Set before any flush.
+void minimap_set_format(const Format *format);
+
+// Call after changing the text of a line, or inserting or removing lines at index
+void minimap_line_changed(int index);
+void minimap_lines_moved(int index);
+
+// Lines on screen in the editor and the cursor line
+void minimap_set_view(int first, int last, int cursor);
+
+// Lines containing pattern are marked, an empty pattern marks none
+void minimap_set_pattern(const char *pattern);
+
+// Redraw the dirty rows, returns the time taken in microseconds
+u32 minimap_flush(char lines[][MAX_LINE_LENGTH], int total);
+
+// Line under the stylus at (x, y), or -1
+int minimap_line_at(int x, int y, int total);
+
+#endif // MINIMAP_H
@@ -0,0 +1,519 @@
+#include <nds.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <dirent.h>
+#include "confedit.h"
+#include "fileio.h"
+#include "backup.h"
+#include "ui.h"
+#include "patch.h"
+
+// Patch script format, one command per line:
+//   # comment
+//   files /path/to/folder/*.ini    target glob (* and ? in the file name)
+//   [SECTION]                      section for the following commands, [] for none
+//   set KEY=VALUE                  change the value of an existing key
+//   add KEY=VALUE                  change the value, or add the key if missing
+//   del KEY                        remove the key
+
+#define PATCH_MAX_TARGETS   8
+#define PATCH_MAX_OPS       64
+#define PATCH_MAX_NAME      64
+#define PATCH_MAX_VALUE     128
+#define PATCH_MAX_REPORT    512
+#define PATCH_BLOCK_SIZE    (16 * 1024)
+#define PATCH_MAX_BLANKS    512     // Blank lines held back before a section ends
+#define PATCH_NAMES_SIZE    (16 * 1024) // Names of the files matched in one folder
+
+enum { OP_SET, OP_ADD, OP_DEL };
+
+typedef struct {
+    u8 type;
+    bool done;                      // Applied to the current file
+    char section[PATCH_MAX_NAME];
+    char key[PATCH_MAX_NAME];
+    char value[PATCH_MAX_VALUE];
+} PatchOp;
+
+typedef struct {
+    FILE *file;
+    int start, end;                 // Unread data in buf[start..end)
+    bool eof;
+    u8 buf[PATCH_BLOCK_SIZE];
+} LineReader;
+
+static char targets[PATCH_MAX_TARGETS][MAX_PATH_LEN];
+static int target_count;
+static PatchOp ops[PATCH_MAX_OPS];
+static int op_count;
+
+// Matched file names of the folder being patched, each followed by a NUL
+static char names[PATCH_NAMES_SIZE];
+
+static char report[PATCH_MAX_REPORT][SCREEN_COLUMNS + 1];
+static int report_count;
+
+// Per file state
+static LineReader reader;
+static const char *file_path;
+static char tmp_path[MAX_PATH_LEN];
+static FILE *out;
+static u8 out_buf[PATCH_BLOCK_SIZE];
+static int out_len;
+static u32 emitted;             // Input bytes known to be identical in the output
+static bool changed;
+static bool dry_run;
+static bool write_failed;
+static bool ends_with_eol;      // Output is at the start of a line
+static char eol[3];             // Line ending used for inserted lines
+static char section[PATCH_MAX_NAME];
+static u8 blanks[PATCH_MAX_BLANKS];
+static int blanks_len;
+static int line_number;
+
+static void add_report(const char *fmt, const char *a, const char *b) {
+    if (report_count >= PATCH_MAX_REPORT) return;
+    char tmp[MAX_PATH_LEN + PATCH_MAX_VALUE];
+    snprintf(tmp, sizeof(tmp), fmt, a, b);
+    snprintf(report[report_count++], SCREEN_COLUMNS + 1, "%s", tmp);
+}
+
+static const char *get_report_line(int index) {
+    return report[index];
+}
+
+static char *trim(char *s) {
+    while (isspace((unsigned char)*s)) s++;
+    char *end = s + strlen(s);
+    while (end > s && isspace((unsigned char)end[-1])) end--;
+    *end = '\0';
+    return s;
+}
+
+static bool parse_script(const char *script_path) {
+    FILE *file = fopen(script_path, "r");
+    if (!file) return false;
+
+    char line[MAX_PATH_LEN + 16];
+    char cur_section[PATCH_MAX_NAME] = "";
+    target_count = 0;
+    op_count = 0;
+
+    while (fgets(line, sizeof(line), file)) {
+        char *s = trim(line);
+        if (*s == '\0' || *s == '#' || *s == ';') continue;
+
+        if (*s == '[') {
+            char *close = strchr(s, ']');
+            if (close) *close = '\0';
+            snprintf(cur_section, sizeof(cur_section), "%s", trim(s + 1));
+        } else if (strncasecmp(s, "files ", 6) == 0) {
+            if (target_count < PATCH_MAX_TARGETS)
+                snprintf(targets[target_count++], MAX_PATH_LEN, "%s", trim(s + 6));
+        } else if (op_count < PATCH_MAX_OPS) {
+            PatchOp *op = &ops[op_count];
+            if (strncasecmp(s, "set ", 4) == 0) op->type = OP_SET;
+            else if (strncasecmp(s, "add ", 4) == 0) op->type = OP_ADD;
+            else if (strncasecmp(s, "del ", 4) == 0) op->type = OP_DEL;
+            else continue;
+
+            char *arg = trim(s + 4);
+            char *eq = strchr(arg, '=');
+            if (eq) {
+                *eq = '\0';
+                snprintf(op->value, sizeof(op->value), "%s", trim(eq + 1));
+            } else {
+                if (op->type != OP_DEL) continue;
+                op->value[0] = '\0';
+            }
+            snprintf(op->key, sizeof(op->key), "%s", trim(arg));
+            strcpy(op->section, cur_section);
+            op_count++;
+        }
+    }
+
+    fclose(file);
+    return target_count > 0 && op_count > 0;
+}
+
+// Case-insensitive match of a file name against * and ? wildcards
+static bool match_wildcard(const char *pat, const char *name) {
+    const char *star = NULL, *retry = NULL;
+
+    while (*name) {
+        if (*pat == '*') {
+            star = ++pat;
+            retry = name;
+        } else if (*pat == '?' || tolower((unsigned char)*pat) == tolower((unsigned char)*name)) {
+            pat++;
+            name++;
+        } else if (star) {
+            pat = star;
+            name = ++retry;
+        } else {
+            return false;
+        }
+    }
+    while (*pat == '*') pat++;
+    return *pat == '\0';
+}
+
+// Returns the length of the next line including its ending, 0 at end of file.
+// A line longer than the block buffer is returned in pieces.
+static int read_line(const u8 **line, int *content_len) {
+    LineReader *r = &reader;
+
+    while (1) {
+        u8 *p = r->buf + r->start;
+        int avail = r->end - r->start;
+
+        for (int i = 0; i < avail; i++) {
+            if (p[i] != '\n' && p[i] != '\r') continue;
+
+            if (p[i] == '\r' && i + 1 == avail && !r->eof) break;  // Need the next byte for CRLF
+            int len = i + 1;
+            if (p[i] == '\r' && i + 1 < avail && p[i + 1] == '\n') len++;
+
+            *line = p;
+            *content_len = i;
+            r->start += len;
+            return len;
+        }
+
+        if (r->eof || (r->start == 0 && r->end == PATCH_BLOCK_SIZE)) {
+            // Last line without ending, or a piece of a very long line
+            *line = p;
+            *content_len = avail;
+            r->start = r->end;
+            return avail;
+        }
+
+        memmove(r->buf, p, avail);
+        r->start = 0;
+        r->end = avail;
+        int n = fread(r->buf + r->end, 1, PATCH_BLOCK_SIZE - r->end, r->file);
+        r->end += n;
+        if (n == 0) r->eof = true;
+    }
+}
+
+static void flush_output(void) {
+    if (out && out_len > 0 && fwrite(out_buf, 1, out_len, out) != (size_t)out_len)
+        write_failed = true;
+    out_len = 0;
+}
+
+static void write_output(const void *data, int len) {
+    if (out_len + len > PATCH_BLOCK_SIZE) flush_output();
+    if (len > PATCH_BLOCK_SIZE) {
+        if (fwrite(data, 1, len, out) != (size_t)len) write_failed = true;
+        return;
+    }
+    memcpy(out_buf + out_len, data, len);
+    out_len += len;
+}
+
+// Copy input bytes that are passed through unchanged
+static void emit_input(const void *data, int len) {
+    if (len == 0) return;
+    ends_with_eol = ((const u8 *)data)[len - 1] == '\n' || ((const u8 *)data)[len - 1] == '\r';
+    if (!changed) {
+        emitted += len;
+        return;
+    }
+    if (out) write_output(data, len);
+}
+
+// First modification: start the output with the untouched part of the input
+static void begin_change(void) {
+    if (changed) return;
+    changed = true;
+    add_report("%s", strrchr(file_path, '/') ? strrchr(file_path, '/') + 1 : file_path, NULL);
+    if (dry_run) return;
+
+    temp_path_for(file_path, tmp_path, sizeof(tmp_path));
+    out = fopen(tmp_path, "wb");
+    FILE *src = fopen(file_path, "rb");
+    if (!out || !src) {
+        write_failed = true;
+        if (src) fclose(src);
+        return;
+    }
+
+    u32 left = emitted;
+    while (left > 0) {
+        int n = fread(out_buf, 1, (left < PATCH_BLOCK_SIZE) ? left : PATCH_BLOCK_SIZE, src);
+        if (n <= 0) {
+            write_failed = true;
+            break;
+        }
+        if (fwrite(out_buf, 1, n, out) != (size_t)n) write_failed = true;
+        left -= n;
+    }
+    fclose(src);
+}
+
+static void emit_key_line(const char *key, const char *value) {
+    char line[PATCH_MAX_NAME + PATCH_MAX_VALUE + 4];
+    int len = snprintf(line, sizeof(line), "%s=%s%s", key, value, eol);
+    if (out) write_output(line, len);
+    ends_with_eol = true;
+}
+
+static void flush_blanks(void) {
+    emit_input(blanks, blanks_len);
+    blanks_len = 0;
+}
+
+// Insert the keys added to the section that is ending
+static void finish_section(void) {
+    for (int i = 0; i < op_count; i++) {
+        PatchOp *op = &ops[i];
+        if (op->type != OP_ADD || op->done || strcasecmp(op->section, section) != 0) continue;
+
+        begin_change();
+        if (!ends_with_eol && out) write_output(eol, strlen(eol));
+        emit_key_line(op->key, op->value);
+        add_report("  +%s=%s", op->key, op->value);
+        op->done = true;
+    }
+}
+
+// Sections that never appeared get appended at the end of the file
+static void append_missing_sections(void) {
+    for (int i = 0; i < op_count; i++) {
+        if (ops[i].type != OP_ADD || ops[i].done) continue;
+
+        begin_change();
+        strcpy(section, ops[i].section);
+        if (!ends_with_eol && out) write_output(eol, strlen(eol));
+        if (section[0]) {
+            char header[PATCH_MAX_NAME + 4];
+            int len = snprintf(header, sizeof(header), "[%s]%s", section, eol);
+            if (out) write_output(header, len);
+            add_report("  +[%s]", section, NULL);
+        }
+        ends_with_eol = true;
+        finish_section();
+    }
+}
+
+static void process_key_line(const u8 *line, int indent, int content_len, int len) {
+    const u8 *eq = memchr(line + indent, '=', content_len - indent);
+    if (!eq) {
+        emit_input(line, len);
+        return;
+    }
+
+    char key[PATCH_MAX_NAME];
+    int key_len = eq - (line + indent);
+    if (key_len >= PATCH_MAX_NAME) key_len = PATCH_MAX_NAME - 1;
+    memcpy(key, line + indent, key_len);
+    key[key_len] = '\0';
+    char *k = trim(key);
+
+    const u8 *value = eq + 1;
+    while (value < line + content_len && (*value == ' ' || *value == '\t')) value++;
+    int value_len = line + content_len - value;
+
+    for (int i = 0; i < op_count; i++) {
+        PatchOp *op = &ops[i];
+        if (op->done || strcasecmp(op->key, k) != 0 || strcasecmp(op->section, section) != 0) continue;
+        op->done = true;
+
+        char old[PATCH_MAX_NAME + PATCH_MAX_VALUE];
+        snprintf(old, sizeof(old), "%s=%.*s", k, value_len, value);
+        char num[12];
+        snprintf(num, sizeof(num), "%d", line_number);
+
+        if (op->type == OP_DEL) {
+            begin_change();
+            add_report("%4s -%s", num, k);
+            return;
+        }
+
+        if ((int)strlen(op->value) == value_len && memcmp(op->value, value, value_len) == 0)
+            break;
+
+        begin_change();
+        if (out) {
+            write_output(line, value - line);
+            write_output(op->value, strlen(op->value));
+            write_output(line + content_len, len - content_len);
+        }
+        ends_with_eol = len > content_len;
+        add_report("%4s -%s", num, old);
+        add_report("     +%s=%s", k, op->value);
+        return;
+    }
+
+    emit_input(line, len);
+}
+
+// Stream one file through the patch, returns true if it was (or would be) changed
+static bool patch_file(const char *path) {
+    reader.file = fopen(path, "rb");
+    if (!reader.file) return false;
+    reader.start = reader.end = 0;
+    reader.eof = false;
+
+    file_path = path;
+    out = NULL;
+    out_len = 0;
+    emitted = 0;
+    changed = false;
+    write_failed = false;
+    ends_with_eol = true;
+    strcpy(eol, "\n");
+    section[0] = '\0';
+    blanks_len = 0;
+    line_number = 0;
+    for (int i = 0; i < op_count; i++) ops[i].done = false;
+
+    const u8 *line;
+    int content_len, len;
+    bool first = true;
+
+    while ((len = read_line(&line, &content_len)) > 0) {
+        line_number++;
+
+        // New lines follow the ending style of the first line
+        if (first && len > content_len) {
+            snprintf(eol, sizeof(eol), "%.*s", len - content_len, line + content_len);
+            first = false;
+        }
+
+        int indent = 0;
+        while (indent < content_len && (line[indent] == ' ' || line[indent] == '\t')) indent++;
+
+        if (indent == content_len) {
+            if (blanks_len + len > PATCH_MAX_BLANKS) flush_blanks();
+            if (len > PATCH_MAX_BLANKS) emit_input(line, len);
+            else {
+                memcpy(blanks + blanks_len, line, len);
+                blanks_len += len;
+            }
+            continue;
+        }
+
+        const u8 *s = line + indent;
+        int n = content_len - indent;
+
+        if (s[0] == '[') {
+            finish_section();
+            flush_blanks();
+            const u8 *close = memchr(s, ']', n);
+            int name_len = close ? close - s - 1 : n - 1;
+            if (name_len >= PATCH_MAX_NAME) name_len = PATCH_MAX_NAME - 1;
+            memcpy(section, s + 1, name_len);
+            section[name_len] = '\0';
+            strcpy(section, trim(section));
+            emit_input(line, len);
+        } else if (s[0] == ';' || s[0] == '#') {
+            flush_blanks();
+            emit_input(line, len);
+        } else {
+            flush_blanks();
+            process_key_line(line, indent, content_len, len);
+        }
+    }
+
+    finish_section();
+    flush_blanks();
+    append_missing_sections();
+
+    fclose(reader.file);
+
+    if (out) {
+        flush_output();
+        if (fclose(out) != 0) write_failed = true;
+        if (!write_failed) backup_move(path);
+        if (write_failed || !commit_temp_file(tmp_path, path)) {
+            remove(tmp_path);
+            add_report("  write failed!", NULL, NULL);
+        }
+    }
+    return changed;
+}
+
+// Run the patch over every target, returns the number of changed files.
+// The matching names of a folder are listed before any file is patched:
+// the temporary files and renames of patching change the folder, and
+// reading it at the same time could return a file twice.
+static int patch_targets(int *matched) {
+    int changed_files = 0;
+    *matched = 0;
+
+    for (int t = 0; t < target_count; t++) {
+        char dir_path[MAX_PATH_LEN];
+        strcpy(dir_path, targets[t]);
+        char *slash = strrchr(dir_path, '/');
+        const char *glob = targets[t] + (slash ? slash - dir_path + 1 : 0);
+        if (slash == dir_path) slash[1] = '\0';
+        else if (slash) *slash = '\0';
+        else strcpy(dir_path, ".");
+
+        DIR *pdir = opendir(dir_path);
+        if (!pdir) {
+            add_report("No folder %s", dir_path, NULL);
+            continue;
+        }
+
+        int names_len = 0, skipped = 0;
+        struct dirent *pent;
+        while ((pent = readdir(pdir)) != NULL) {
+            if (pent->d_type == DT_DIR || !is_supported_file(pent->d_name)) continue;
+            if (!match_wildcard(glob, pent->d_name)) continue;
+
+            int len = strlen(pent->d_name) + 1;
+            if (names_len + len > PATCH_NAMES_SIZE) {
+                skipped++;
+                continue;
+            }
+            memcpy(names + names_len, pent->d_name, len);
+            names_len += len;
+        }
+        closedir(pdir);
+
+        for (int n = 0; n < names_len; n += strlen(names + n) + 1) {
+            char path[MAX_PATH_LEN];
+            snprintf(path, sizeof(path), "%s%s%s", dir_path,
+                     (strcmp(dir_path, "/") == 0) ? "" : "/", names + n);
+            (*matched)++;
+            if (patch_file(path)) changed_files++;
+        }
+        if (skipped > 0) {
+            char count[12];
+            snprintf(count, sizeof(count), "%d", skipped);
+            add_report("%s more files in %s skipped", count, dir_path);
+        }
+    }
+    return changed_files;
+}
+
+void patch_run(const char *script_path) {
+    if (!parse_script(script_path)) {
+        ui_message("Not a patch script, expected\n\"files <glob>\" and at least one\nset/add/del line.");
+        return;
+    }
+
+    static const char *const modes[] = { "Dry run (show diff)", "Apply" };
+    int mode = ui_menu("Patch script", modes, 2);
+    if (mode < 0) return;
+    dry_run = (mode == 0);
+
+    consoleClear();
+    iprintf("%s...", dry_run ? "Checking" : "Patching");
+
+    report_count = 0;
+    int matched;
+    cpuStartTiming(0);
+    int changed_files = patch_targets(&matched);
+    u32 ms = timerTicks2msec(cpuEndTiming());
+
+    char title[SCREEN_COLUMNS * 2 + 1];
+    snprintf(title, sizeof(title), "%s %d/%d files in %lums",
+             dry_run ? "Would change" : "Changed", changed_files, matched, (unsigned long)ms);
+    ui_view_lines(title, get_report_line, report_count, KEY_B);
+}
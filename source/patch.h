@@ -0,0 +1,8 @@
+#ifndef PATCH_H
+#define PATCH_H
+
+// Run the patch script at script_path on every file it targets.
+// The user picks between a dry run showing the diff and applying it.
+void patch_run(const char *script_path);
+
+#endif // PATCH_H
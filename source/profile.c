@@ -0,0 +1,69 @@
+#include <nds.h>
+#include <stdlib.h>
+#include "confedit.h"
+#include "hexview.h"
+#include "profile.h"
+
+// An Entry and its SortKey in the browser, for the memory check
+#define ENTRY_BYTES     (MAX_PATH_LEN + 32)
+
+static const Profile profiles[TIER_COUNT] = {
+    [TIER_DS] = {
+        .name = "DS",
+        .main_ram = 4 << 20,
+        .fast_cpu = false,
+        .max_entries = 512,
+        .buffer_pool = 512 * 1024,
+        .clip_pool = 128 * 1024,
+        .hex_pages = 3,         // Two pages can be on screen, plus the prefetched one
+    },
+    [TIER_DSI] = {
+        .name = "DSi",
+        .main_ram = 16 << 20,
+        .fast_cpu = true,
+        .max_entries = 4096,
+        .buffer_pool = 6 << 20,
+        .clip_pool = 1 << 20,
+        .hex_pages = 64,
+    },
+};
+
+static int tier = TIER_DS;
+static bool fast_clock;
+
+static u32 pool_bytes(const Profile *p) {
+    return p->max_entries * ENTRY_BYTES + p->buffer_pool + p->clip_pool + p->hex_pages * (HEX_PAGE_SIZE + 16);
+}
+
+void profile_init(void) {
+#ifdef CONFEDIT_TIER
+    tier = CONFEDIT_TIER;
+#else
+    tier = isDSiMode() ? TIER_DSI : TIER_DS;
+#endif
+
+    // The DS profile is what the editor used to reserve statically, the
+    // others are checked against the heap before anything is allocated
+    if (tier != TIER_DS) {
+        void *probe = malloc(pool_bytes(&profiles[tier]));
+        if (!probe) tier = TIER_DS;
+        free(probe);
+    }
+
+    if (profiles[tier].fast_cpu && isDSiMode()) {
+        setCpuClock(true);
+        fast_clock = true;
+    }
+}
+
+const Profile *profile_get(void) {
+    return &profiles[tier];
+}
+
+int profile_tier(void) {
+    return tier;
+}
+
+int profile_cpu_mhz(void) {
+    return fast_clock ? 134 : 67;
+}
@@ -0,0 +1,40 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <nds.h>
+
+// Memory tier of the console, detected at startup. A DS has 4MB of main RAM
+// and a 67MHz ARM9. A DSi, or a 3DS running the editor in DSi mode, has 16MB
+// and can run the ARM9 at 134MHz. The pools and caches sized at runtime
+// take their size from the profile of the tier. The per-file limits of
+// confedit.h stay compile-time constants, they size arrays every module shares.
+
+enum {
+    TIER_DS,
+    TIER_DSI,
+    TIER_COUNT
+};
+
+typedef struct {
+    const char *name;
+    u32 main_ram;           // Bytes of main RAM
+    bool fast_cpu;          // ARM9 at 134MHz
+    int max_entries;        // Directory entries listed by the browser
+    u32 buffer_pool;        // Bytes for the open files not being edited
+    u32 clip_pool;          // Bytes of clipboard text detached from the buffer
+    int hex_pages;          // 4KB pages cached by the hex view
+} Profile;
+
+// Detect the tier and switch to the faster clock when there is one.
+// Building with TIER=ds or TIER=dsi forces a tier, to compare them on any
+// console or emulator. A tier whose pools do not fit in the free memory
+// falls back to the DS profile.
+void profile_init(void);
+
+const Profile *profile_get(void);
+int profile_tier(void);
+
+// ARM9 clock, once profile_init() switched it
+int profile_cpu_mhz(void);
+
+#endif // PROFILE_H
@@ -0,0 +1,473 @@
+#include <nds.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include "confedit.h"
+#include "schema.h"
+
+#define SCHEMA_MAX_SECTIONS 254
+#define SECTION_NONE        0xFF    // Section the schema does not name, not checked
+#define LINE_HEADER         0x80    // Status bit of section header lines
+
+static const SchemaRule *rules;     // NULL when the file has no schema
+static int rule_count;
+
+// Sections of the schema: section s holds rules section_first[s]..section_first[s + 1] - 1
+static int section_count;
+static u16 section_first[SCHEMA_MAX_SECTIONS + 1];
+static bool section_open[SCHEMA_MAX_SECTIONS];
+static u8 top_section;              // Section of the keys before any header
+
+// Schemas read from the card, one after the other, with the names they
+// were looked up for, so activating a buffer again reads nothing
+typedef struct {
+    char name[MAX_PATH_LEN];
+    int first, count;       // Rules in loaded_rules, count -1 if there is no schema on the card
+} CardSchema;
+
+static CardSchema card_schemas[SCHEMA_CACHE_SIZE];
+static int card_schema_count;
+static SchemaRule loaded_rules[SCHEMA_MAX_RULES];
+static int loaded_rule_count;
+static char loaded_pool[SCHEMA_POOL_SIZE];
+static u32 loaded_pool_used;
+
+// Result of each line, kept in step with the buffer like the fold cache
+static int line_count;
+static u8 line_section[MAX_LINES];
+static u8 line_status[MAX_LINES];   // SCHEMA_OK... | LINE_HEADER
+
+// Lines pending_from..pending_to changed section, the lines after them up
+// to the next header have to be checked again
+static int pending_from = MAX_LINES, pending_to = -1;
+
+// Case ignored comparison of len characters at a with the string b
+static int compare_name(const char *a, int len, const char *b) {
+    int diff = strncasecmp(a, b, len);
+    if (diff == 0 && b[len] != '\0') diff = -1;
+    return diff;
+}
+
+static int compare_rules(const void *a, const void *b) {
+    const SchemaRule *ra = a;
+    const SchemaRule *rb = b;
+    int diff = strcasecmp(ra->section, rb->section);
+    return diff ? diff : strcasecmp(ra->key, rb->key);
+}
+
+static const char *skip_blanks(const char *p) {
+    while (*p == ' ' || *p == '\t') p++;
+    return p;
+}
+
+// Length of text once the trailing blanks are cut
+static int trimmed_length(const char *text, int len) {
+    while (len > 0 && (text[len - 1] == ' ' || text[len - 1] == '\t' || text[len - 1] == '\r' || text[len - 1] == '\n')) len--;
+    return len;
+}
+
+// Name of a "[name]" header line, trimmed
+static bool parse_header(const char *line, const char **name, int *len) {
+    line = skip_blanks(line);
+    if (*line != '[') return false;
+    const char *end = strchr(line, ']');
+    if (!end) return false;
+
+    *name = skip_blanks(line + 1);
+    *len = trimmed_length(*name, end - *name);
+    if (*len < 0) *len = 0;
+    return true;
+}
+
+// Key and value of a "key = value" line, trimmed. False for comments,
+// blank lines and lines without '='.
+static bool parse_pair(const char *line, const char **key, int *key_len, const char **value, int *value_len) {
+    line = skip_blanks(line);
+    if (*line == '#' || *line == ';') return false;
+    const char *equal = strchr(line, '=');
+    if (!equal) return false;
+
+    *key = line;
+    *key_len = trimmed_length(line, equal - line);
+    *value = skip_blanks(equal + 1);
+    *value_len = trimmed_length(*value, strlen(*value));
+    return *key_len > 0;
+}
+
+static int find_section(const char *name, int len) {
+    int lo = 0, hi = section_count - 1;
+    while (lo <= hi) {
+        int mid = (lo + hi) / 2;
+        int diff = compare_name(name, len, rules[section_first[mid]].section);
+        if (diff == 0) return mid;
+        if (diff < 0) hi = mid - 1;
+        else lo = mid + 1;
+    }
+    return SECTION_NONE;
+}
+
+static const SchemaRule *find_rule(int section, const char *key, int len) {
+    int lo = section_first[section], hi = section_first[section + 1] - 1;
+    while (lo <= hi) {
+        int mid = (lo + hi) / 2;
+        int diff = compare_name(key, len, rules[mid].key);
+        if (diff == 0) return &rules[mid];
+        if (diff < 0) hi = mid - 1;
+        else lo = mid + 1;
+    }
+    return NULL;
+}
+
+static bool check_value(const SchemaRule *rule, const char *value, int len) {
+    char text[MAX_LINE_LENGTH];
+    memcpy(text, value, len);
+    text[len] = '\0';
+
+    switch (rule->type) {
+    case SCHEMA_BOOL:
+        return strcmp(text, "0") == 0 || strcmp(text, "1") == 0 ||
+               strcasecmp(text, "true") == 0 || strcasecmp(text, "false") == 0;
+
+    case SCHEMA_INT: {
+        char *end;
+        long number = strtol(text, &end, 10);
+        return len > 0 && *end == '\0' && number >= rule->min && number <= rule->max;
+    }
+
+    case SCHEMA_HEX: {
+        const char *digits = (strncasecmp(text, "0x", 2) == 0) ? text + 2 : text;
+        int count = strspn(digits, "0123456789abcdefABCDEF");
+        return count > 0 && count <= 8 && digits[count] == '\0';
+    }
+
+    case SCHEMA_ENUM: {
+        const char *word = rule->words;
+        while (*word) {
+            int word_len = strcspn(word, " ");
+            if (word_len == len && strncasecmp(word, text, len) == 0) return true;
+            word += word_len;
+            while (*word == ' ') word++;
+        }
+        return false;
+    }
+
+    default:
+        return true;
+    }
+}
+
+// Check one line, its section following from the line above
+static void check_line(char lines[][MAX_LINE_LENGTH], int index) {
+    const char *line = lines[index];
+    const char *name, *value;
+    int len, value_len;
+
+    if (parse_header(line, &name, &len)) {
+        line_section[index] = find_section(name, len);
+        line_status[index] = SCHEMA_OK | LINE_HEADER;
+        return;
+    }
+
+    int section = (index > 0) ? line_section[index - 1] : top_section;
+    line_section[index] = section;
+    line_status[index] = SCHEMA_OK;
+    if (section == SECTION_NONE || !parse_pair(line, &name, &len, &value, &value_len)) return;
+
+    const SchemaRule *rule = find_rule(section, name, len);
+    if (!rule) {
+        if (!section_open[section]) line_status[index] = SCHEMA_UNKNOWN_KEY;
+    } else if (!check_value(rule, value, value_len)) {
+        line_status[index] = SCHEMA_BAD_VALUE;
+    }
+}
+
+static void mark_pending(int index) {
+    if (index < pending_from) pending_from = index;
+    if (index > pending_to) pending_to = index;
+}
+
+// Copy len characters into the pool, NULL once it is full
+static const char *pool_add(const char *text, int len) {
+    if (loaded_pool_used + len + 1 > SCHEMA_POOL_SIZE) return NULL;
+    char *copy = loaded_pool + loaded_pool_used;
+    memcpy(copy, text, len);
+    copy[len] = '\0';
+    loaded_pool_used += len + 1;
+    return copy;
+}
+
+// Add the rule or section header of a schema file line to loaded_rules.
+// Returns false once the pool is full.
+static bool parse_rule(char *line, const char **section, int *count) {
+    static const char *const types[] = { "string", "bool", "int", "hex", "enum" };
+
+    const char *header;
+    int len;
+    if (parse_header(line, &header, &len)) {
+        *section = pool_add(header, len);
+        return *section != NULL;
+    }
+
+    char *key = strtok(line, " \t\r\n");
+    if (!key || key[0] == '#') return true;
+
+    SchemaRule *rule = &loaded_rules[*count];
+    rule->section = *section;
+    rule->key = pool_add(key, strlen(key));
+    rule->min = INT32_MIN;
+    rule->max = INT32_MAX;
+    rule->words = "";
+    if (!rule->key) return false;
+
+    if (strcmp(key, "*") == 0) {
+        rule->type = SCHEMA_ANY_KEY;
+        (*count)++;
+        return true;
+    }
+
+    const char *type = strtok(NULL, " \t\r\n");
+    int t = 0;
+    while (type && t < (int)(sizeof(types) / sizeof(types[0])) && strcasecmp(type, types[t]) != 0) t++;
+    if (!type || t == (int)(sizeof(types) / sizeof(types[0]))) return true;
+    rule->type = t;
+
+    if (t == SCHEMA_INT) {
+        const char *min = strtok(NULL, " \t\r\n");
+        const char *max = min ? strtok(NULL, " \t\r\n") : NULL;
+        if (min) rule->min = strtol(min, NULL, 10);
+        if (max) rule->max = strtol(max, NULL, 10);
+    } else if (t == SCHEMA_ENUM) {
+        // The words are joined back with single spaces
+        char words[MAX_LINE_LENGTH] = "";
+        const char *word;
+        while ((word = strtok(NULL, " \t\r\n")) != NULL) {
+            if (words[0]) strcat(words, " ");
+            strcat(words, word);
+        }
+        rule->words = pool_add(words, strlen(words));
+        if (!rule->words) return false;
+    }
+    (*count)++;
+    return true;
+}
+
+// Read /_nds/ConfEdit/schema/<name>.txt into loaded_rules from first on.
+// Returns the rule count, -1 if there is none. full is set if the rules or
+// the pool ran out before the end of the file.
+static int load_card_schema(const char *name, int first, bool *full) {
+    char path[MAX_PATH_LEN];
+    snprintf(path, sizeof(path), "%s/schema/%s.txt", CONFEDIT_DIR, name);
+    *full = false;
+    FILE *file = fopen(path, "rb");
+    if (!file) return -1;
+
+    const char *section = "";
+    int count = first;
+
+    char line[MAX_LINE_LENGTH];
+    while (fgets(line, sizeof(line), file)) {
+        if (count == SCHEMA_MAX_RULES || !parse_rule(line, &section, &count)) {
+            *full = true;
+            break;
+        }
+    }
+    fclose(file);
+
+    qsort(loaded_rules + first, count - first, sizeof(SchemaRule), compare_rules);
+    return count - first;
+}
+
+void schema_forget_card(void) {
+    card_schema_count = 0;
+    loaded_rule_count = 0;
+    loaded_pool_used = 0;
+}
+
+// Rules of the schema on the card for the file name, NULL if there is none.
+// Only names not seen before are looked up on the card.
+static const SchemaRule *card_schema(const char *name, int *count) {
+    CardSchema *cached = NULL;
+    for (int i = 0; i < card_schema_count && !cached; i++) {
+        if (strcasecmp(card_schemas[i].name, name) == 0) cached = &card_schemas[i];
+    }
+
+    if (!cached) {
+        // Out of room, the schemas are read again as they are needed
+        if (card_schema_count == SCHEMA_CACHE_SIZE) schema_forget_card();
+        bool full;
+        int first = loaded_rule_count;
+        int n = load_card_schema(name, first, &full);
+        if (full && first > 0) {
+            schema_forget_card();
+            first = 0;
+            n = load_card_schema(name, first, &full);
+        }
+
+        cached = &card_schemas[card_schema_count++];
+        strncpy(cached->name, name, sizeof(cached->name) - 1);
+        cached->name[sizeof(cached->name) - 1] = '\0';
+        cached->first = first;
+        cached->count = n;
+        if (n > 0) loaded_rule_count = first + n;
+    }
+
+    *count = cached->count;
+    return (cached->count >= 0) ? loaded_rules + cached->first : NULL;
+}
+
+// Debug builds stop on a built-in table out of order, its lookups would miss rules
+static void check_builtin_order(void) {
+    static bool checked;
+    if (checked) return;
+    checked = true;
+
+    for (int s = 0; s < builtin_schema_count; s++) {
+        for (int i = 1; i < builtin_schemas[s].count; i++) {
+            sassert(compare_rules(&builtin_schemas[s].rules[i - 1], &builtin_schemas[s].rules[i]) < 0,
+                    "Built-in schema %s\nnot sorted at %s", builtin_schemas[s].file, builtin_schemas[s].rules[i].key);
+        }
+    }
+}
+
+// Section table of the sorted rules
+static void index_sections(void) {
+    section_count = 0;
+    for (int i = 0; i < rule_count; i++) {
+        if (i == 0 || strcasecmp(rules[i].section, rules[i - 1].section) != 0) {
+            if (section_count == SCHEMA_MAX_SECTIONS) {
+                rule_count = i;
+                break;
+            }
+            section_first[section_count] = i;
+            section_open[section_count] = false;
+            section_count++;
+        }
+        if (rules[i].type == SCHEMA_ANY_KEY) section_open[section_count - 1] = true;
+    }
+    section_first[section_count] = rule_count;
+    top_section = find_section("", 0);
+}
+
+void schema_reset(const char *filepath, char lines[][MAX_LINE_LENGTH], int total) {
+    const char *slash = filepath ? strrchr(filepath, '/') : NULL;
+    const char *name = slash ? slash + 1 : filepath;
+
+    check_builtin_order();
+
+    rules = name ? card_schema(name, &rule_count) : NULL;
+    if (!rules) {
+        for (int i = 0; name && i < builtin_schema_count; i++) {
+            if (strcasecmp(builtin_schemas[i].file, name) == 0) {
+                rules = builtin_schemas[i].rules;
+                rule_count = builtin_schemas[i].count;
+            }
+        }
+    }
+
+    line_count = total;
+    pending_from = MAX_LINES;
+    pending_to = -1;
+    memset(line_status, SCHEMA_OK, sizeof(line_status));
+    if (!rules) return;
+
+    index_sections();
+    for (int i = 0; i < total; i++) check_line(lines, i);
+}
+
+void schema_update_line(char lines[][MAX_LINE_LENGTH], int index) {
+    if (!rules) return;
+
+    bool was_header = line_status[index] & LINE_HEADER;
+    u8 old_section = line_section[index];
+    check_line(lines, index);
+
+    // Lines below follow a changed section, and a line inside a pending
+    // range may have been checked with a stale section
+    if (was_header || (line_status[index] & LINE_HEADER) || line_section[index] != old_section || index > pending_from)
+        mark_pending(index);
+}
+
+void schema_insert_lines(int index, int count) {
+    int moved = line_count - index;
+    memmove(&line_section[index + count], &line_section[index], moved);
+    memmove(&line_status[index + count], &line_status[index], moved);
+    memset(&line_section[index], (index > 0) ? line_section[index - 1] : top_section, count);
+    memset(&line_status[index], SCHEMA_OK, count);
+    line_count += count;
+
+    if (pending_from >= index && pending_to >= 0) pending_from += count;
+    if (pending_to >= index) pending_to += count;
+}
+
+void schema_remove_lines(int index, int count) {
+    bool header = false;
+    for (int i = index; i < index + count; i++) {
+        if (line_status[i] & LINE_HEADER) header = true;
+    }
+
+    int moved = line_count - index - count;
+    memmove(&line_section[index], &line_section[index + count], moved);
+    memmove(&line_status[index], &line_status[index + count], moved);
+    line_count -= count;
+
+    // A pending range losing lines keeps its place
+    bool pending = pending_to >= index;
+    if (pending_to >= 0) {
+        if (pending_from >= index + count) pending_from -= count;
+        else if (pending_from > index) pending_from = index;
+        if (pending_to >= index + count) pending_to -= count;
+        else if (pending_to >= index) pending_to = index - 1;
+    }
+
+    if ((header || pending) && index < line_count) mark_pending(index);
+    if (pending_to < pending_from) {
+        pending_from = MAX_LINES;
+        pending_to = -1;
+    }
+}
+
+void schema_flush(char lines[][MAX_LINE_LENGTH]) {
+    if (!rules || pending_to < 0) return;
+
+    for (int i = pending_from; i < line_count; i++) {
+        if (i > pending_to && (line_status[i] & LINE_HEADER)) break;
+        check_line(lines, i);
+    }
+    pending_from = MAX_LINES;
+    pending_to = -1;
+}
+
+int schema_status(int line) {
+    return line_status[line] & ~LINE_HEADER;
+}
+
+void schema_message(char lines[][MAX_LINE_LENGTH], int line, char *out, int size) {
+    out[0] = '\0';
+    int status = schema_status(line);
+    const char *key, *value;
+    int key_len, value_len;
+    if (status == SCHEMA_OK || !parse_pair(lines[line], &key, &key_len, &value, &value_len)) return;
+
+    const char *section = rules[section_first[line_section[line]]].section;
+    if (status == SCHEMA_UNKNOWN_KEY) {
+        snprintf(out, size, "Unknown key %.*s in [%s]", key_len, key, section);
+        return;
+    }
+
+    const SchemaRule *rule = find_rule(line_section[line], key, key_len);
+    switch (rule->type) {
+    case SCHEMA_BOOL:
+        snprintf(out, size, "%s: 0, 1, true or false", rule->key);
+        break;
+    case SCHEMA_INT:
+        snprintf(out, size, "%s: number from %ld to %ld", rule->key, (long)rule->min, (long)rule->max);
+        break;
+    case SCHEMA_HEX:
+        snprintf(out, size, "%s: hexadecimal number", rule->key);
+        break;
+    case SCHEMA_ENUM:
+        snprintf(out, size, "%s: one of %s", rule->key, rule->words);
+        break;
+    }
+}
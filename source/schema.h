@@ -0,0 +1,85 @@
+#ifndef SCHEMA_H
+#define SCHEMA_H
+
+#include <nds.h>
+#include "confedit.h"
+
+// Validation of INI style files against a schema: the keys each section
+// holds and the values they take. The schema of a file is looked up by its
+// name, first on the card:
+//   /_nds/ConfEdit/schema/<file name>.txt, e.g. nds-bootstrap.ini.txt
+// then in the tables built in (schemas.c). Rules are sorted by section and
+// key, each changed line costs two binary searches whatever the file size.
+//
+// Schema files:
+//   # Comment
+//   [SECTION]          Following keys belong to SECTION, [] for keys before any section
+//   *                  Other keys are allowed in the section, else they are flagged
+//   KEY bool           0, 1, true or false
+//   KEY int MIN MAX    Decimal number from MIN to MAX
+//   KEY hex            Hexadecimal number, with or without 0x
+//   KEY enum A B C     One of the words
+//   KEY string         Anything
+// Sections the schema does not name are not checked.
+
+#define SCHEMA_MAX_RULES    512
+#define SCHEMA_POOL_SIZE    (16 * 1024)     // Bytes of names and words of the schemas read from the card
+#define SCHEMA_CACHE_SIZE   16              // File names whose schema on the card is kept in RAM
+
+enum {
+    SCHEMA_STRING,
+    SCHEMA_BOOL,
+    SCHEMA_INT,
+    SCHEMA_HEX,
+    SCHEMA_ENUM,
+    SCHEMA_ANY_KEY      // Rule with key "*"
+};
+
+// Status of a line
+enum {
+    SCHEMA_OK,
+    SCHEMA_UNKNOWN_KEY,
+    SCHEMA_BAD_VALUE
+};
+
+typedef struct {
+    const char *section;    // "" for keys before any section
+    const char *key;
+    u8 type;
+    s32 min, max;           // SCHEMA_INT
+    const char *words;      // SCHEMA_ENUM, separated by spaces
+} SchemaRule;
+
+typedef struct {
+    const char *file;           // File name, case is ignored
+    const SchemaRule *rules;    // Sorted by section, then key, case ignored
+    int count;
+} Schema;
+
+// Built-in schemas, schemas.c
+extern const Schema builtin_schemas[];
+extern const int builtin_schema_count;
+
+// Pick the schema of filepath and check every line. Files without a schema,
+// or a NULL filepath for formats schemas don't apply to, have every line
+// reported as fine.
+void schema_reset(const char *filepath, char lines[][MAX_LINE_LENGTH], int total);
+
+// Schema files on the card may have changed, read them again when next needed
+void schema_forget_card(void);
+
+// Call after changing the text of a line, or inserting or removing lines at index
+void schema_update_line(char lines[][MAX_LINE_LENGTH], int index);
+void schema_insert_lines(int index, int count);
+void schema_remove_lines(int index, int count);
+
+// Recheck the lines whose section changed with an edited or removed section
+// header, up to the next header. Call before schema_status().
+void schema_flush(char lines[][MAX_LINE_LENGTH]);
+
+int schema_status(int line);
+
+// What is wrong with line, in at most size - 1 characters, empty if nothing
+void schema_message(char lines[][MAX_LINE_LENGTH], int line, char *out, int size);
+
+#endif // SCHEMA_H
@@ -0,0 +1,40 @@
+#include <nds.h>
+#include "confedit.h"
+#include "schema.h"
+
+// Schemas built into ConfEdit, used in place from ROM. Each table is sorted
+// by section, then key, ignoring case ('*' and '_' sort before letters), as
+// schema.c searches it by halves; debug builds check the order on first use.
+// A schema on the card with the same file name replaces them.
+
+#define RULE_COUNT(rules)   ((int)(sizeof(rules) / sizeof((rules)[0])))
+
+// nds-bootstrap settings. Only the keys whose values are fixed are listed,
+// the others are allowed.
+static const SchemaRule nds_bootstrap_rules[] = {
+    { "NDS-BOOTSTRAP", "*",                      SCHEMA_ANY_KEY },
+    { "NDS-BOOTSTRAP", "ASYNC_CARD_READ",        SCHEMA_BOOL },
+    { "NDS-BOOTSTRAP", "BOOST_CPU",              SCHEMA_BOOL },
+    { "NDS-BOOTSTRAP", "BOOST_VRAM",             SCHEMA_BOOL },
+    { "NDS-BOOTSTRAP", "CARD_READ_DMA",          SCHEMA_BOOL },
+    { "NDS-BOOTSTRAP", "CONSOLE_MODEL",          SCHEMA_INT, 0, 3 },
+    { "NDS-BOOTSTRAP", "DEBUG",                  SCHEMA_BOOL },
+    { "NDS-BOOTSTRAP", "FORCE_SLEEP_PATCH",      SCHEMA_BOOL },
+    { "NDS-BOOTSTRAP", "HOTKEY",                 SCHEMA_HEX },
+    { "NDS-BOOTSTRAP", "LANGUAGE",               SCHEMA_INT, -1, 7 },
+    { "NDS-BOOTSTRAP", "LOGGING",                SCHEMA_BOOL },
+    { "NDS-BOOTSTRAP", "MACRO_MODE",             SCHEMA_BOOL },
+    { "NDS-BOOTSTRAP", "NDS_PATH",               SCHEMA_STRING },
+    { "NDS-BOOTSTRAP", "PRECISE_VOLUME_CONTROL", SCHEMA_BOOL },
+    { "NDS-BOOTSTRAP", "ROMREAD_LED",            SCHEMA_INT, 0, 3 },
+    { "NDS-BOOTSTRAP", "SAV_PATH",               SCHEMA_STRING },
+    { "NDS-BOOTSTRAP", "SDNAND",                 SCHEMA_BOOL },
+    { "NDS-BOOTSTRAP", "SLEEP_MODE",             SCHEMA_BOOL },
+    { "NDS-BOOTSTRAP", "SOUND_FREQ",             SCHEMA_BOOL },
+};
+
+const Schema builtin_schemas[] = {
+    { "nds-bootstrap.ini", nds_bootstrap_rules, RULE_COUNT(nds_bootstrap_rules) },
+};
+
+const int builtin_schema_count = sizeof(builtin_schemas) / sizeof(builtin_schemas[0]);
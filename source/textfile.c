@@ -0,0 +1,222 @@
+#include <nds.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "confedit.h"
+#include "fileio.h"
+#include "backup.h"
+#include "textfile.h"
+
+const char *const eol_bytes[] = { "", "\n", "\r\n", "\r" };
+static const u8 eol_length[] = { 0, 1, 2, 1 };
+
+bool text_reader_open(TextReader *r, const char *filepath) {
+    r->file = fopen(filepath, "rb");
+    if (!r->file) return false;
+
+    r->start = r->end = 0;
+    r->eof = false;
+    r->utf8 = false;
+    r->binary = false;
+    memset(r->eol_count, 0, sizeof(r->eol_count));
+
+    r->end = fread(r->buf, 1, TEXT_BLOCK_SIZE, r->file);
+    if (r->end < TEXT_BLOCK_SIZE) r->eof = true;
+
+    r->bom = (r->end >= 3 && r->buf[0] == 0xEF && r->buf[1] == 0xBB && r->buf[2] == 0xBF);
+    if (r->bom) r->start = 3;
+    return true;
+}
+
+void text_reader_close(TextReader *r) {
+    if (r->file) fclose(r->file);
+    r->file = NULL;
+}
+
+int utf8_sequence(const u8 *p, int avail) {
+    int n;
+    if (p[0] >= 0xC2 && p[0] <= 0xDF) n = 2;
+    else if (p[0] >= 0xE0 && p[0] <= 0xEF) n = 3;
+    else if (p[0] >= 0xF0 && p[0] <= 0xF4) n = 4;
+    else return 0;
+
+    if (n > avail) return 0;
+    for (int i = 1; i < n; i++) {
+        if ((p[i] & 0xC0) != 0x80) return 0;
+    }
+    return n;
+}
+
+int text_reader_next(TextReader *r, const u8 **line, int *len) {
+    int avail = r->end - r->start;
+
+    // Keep at least one full line and the byte after it in the buffer
+    if (!r->eof && avail <= MAX_LINE_LENGTH) {
+        memmove(r->buf, r->buf + r->start, avail);
+        r->start = 0;
+        r->end = avail;
+        int n = fread(r->buf + avail, 1, TEXT_BLOCK_SIZE - avail, r->file);
+        r->end += n;
+        if (n < TEXT_BLOCK_SIZE - avail) r->eof = true;
+        avail = r->end;
+    }
+    if (avail == 0) return -1;
+
+    const u8 *p = r->buf + r->start;
+    int limit = (avail < MAX_LINE_LENGTH - 1) ? avail : MAX_LINE_LENGTH - 1;
+    int eol = EOL_NONE;
+    int i = 0;
+
+    while (i < limit) {
+        u8 c = p[i];
+        if (c >= 0x80) {
+            int n = utf8_sequence(p + i, avail - i);
+            if (n > 0) {
+                if (i + n > limit) break;  // Split long lines before the sequence
+                r->utf8 = true;
+                i += n;
+                continue;
+            }
+        } else if (c == '\n') {
+            eol = EOL_LF;
+            break;
+        } else if (c == '\r') {
+            eol = (i + 1 < avail && p[i + 1] == '\n') ? EOL_CRLF : EOL_CR;
+            break;
+        } else if (c == 0) {
+            r->binary = true;
+        }
+        i++;
+    }
+
+    *line = p;
+    *len = i;
+    r->start += i + eol_length[eol];
+    r->eol_count[eol]++;
+    return eol;
+}
+
+// Modification time of filepath, 0 if unknown
+static time_t file_mtime(const char *filepath) {
+    struct stat st;
+    return (stat(filepath, &st) == 0) ? st.st_mtime : 0;
+}
+
+bool text_file_changed(const char *filepath, const TextFileInfo *info) {
+    struct stat st;
+    return stat(filepath, &st) != 0 || (u32)st.st_size != info->disk_size || st.st_mtime != info->disk_mtime;
+}
+
+int load_text_file(const char *filepath, char file_lines[][MAX_LINE_LENGTH], TextFileInfo *info) {
+    static TextReader reader;
+    if (!text_reader_open(&reader, filepath)) return -1;
+
+    int total_lines = 0;
+    const u8 *line;
+    int len, eol;
+
+    info->disk_size = reader.bom ? 3 : 0;
+    while (total_lines < MAX_LINES && (eol = text_reader_next(&reader, &line, &len)) >= 0) {
+        memcpy(file_lines[total_lines], line, len);
+        file_lines[total_lines][len] = '\0';
+        info->line_eol[total_lines] = eol;
+        info->disk_size += len + eol_length[eol];
+        total_lines++;
+    }
+
+    // Content past MAX_LINES is dropped, saving would delete it from the card
+    bool truncated = reader.start < reader.end || !reader.eof;
+    text_reader_close(&reader);
+
+    if (total_lines == 0) {
+        file_lines[0][0] = '\0';
+        info->line_eol[0] = EOL_NONE;
+        total_lines = 1;
+    }
+
+    info->disk_mtime = file_mtime(filepath);
+    info->dirty_line = total_lines;
+    info->backed_up = false;
+    info->truncated = truncated;
+    info->bom = reader.bom;
+    info->utf8 = reader.utf8;
+    info->binary = reader.binary;
+
+    // New lines use the most common ending, LF if there is none
+    info->eol = EOL_LF;
+    if (reader.eol_count[EOL_CRLF] > reader.eol_count[info->eol]) info->eol = EOL_CRLF;
+    if (reader.eol_count[EOL_CR] > reader.eol_count[info->eol]) info->eol = EOL_CR;
+
+    return total_lines;
+}
+
+// Bytes save_file() writes for lines [first, last)
+static u32 serialized_size(char file_lines[][MAX_LINE_LENGTH], const TextFileInfo *info, int first, int last) {
+    u32 size = (first == 0 && info->bom) ? 3 : 0;
+    for (int i = first; i < last; i++)
+        size += strlen(file_lines[i]) + eol_length[info->line_eol[i]];
+    return size;
+}
+
+static int write_lines(FILE *file, char file_lines[][MAX_LINE_LENGTH], const TextFileInfo *info, int first, int total_lines) {
+    int written = 0;
+    if (first == 0 && info->bom) {
+        if (fwrite("\xEF\xBB\xBF", 1, 3, file) != 3) return -1;
+        written += 3;
+    }
+    for (int i = first; i < total_lines; i++) {
+        int len = strlen(file_lines[i]);
+        int eol = info->line_eol[i];
+        if (fwrite(file_lines[i], 1, len, file) != (size_t)len ||
+            fwrite(eol_bytes[eol], 1, eol_length[eol], file) != eol_length[eol])
+            return -1;
+        written += len + eol_length[eol];
+    }
+    return written;
+}
+
+// When everything before info->dirty_line is unchanged on disk and the file
+// does not shrink, only the tail from the first modified line is rewritten.
+// A file changed on the card since it was read is rewritten whole, its head
+// may not be the buffer's any more. So is a file saved for the first time
+// since it was read: the old version is renamed into the backups, which
+// writes nothing, where keeping it before an in-place write copies it all.
+int save_file(const char *filepath, char file_lines[][MAX_LINE_LENGTH], int total_lines, TextFileInfo *info) {
+    if (info->binary || info->truncated) return -1;
+
+    u32 dirty_offset = serialized_size(file_lines, info, 0, info->dirty_line);
+    u32 new_size = dirty_offset + serialized_size(file_lines, info, info->dirty_line, total_lines);
+    int written = -1;
+
+    if (info->backed_up && info->dirty_line > 0 && new_size >= info->disk_size && !text_file_changed(filepath, info)) {
+        FILE *file = fopen(filepath, "r+b");
+        if (file) {
+            if (fseek(file, dirty_offset, SEEK_SET) == 0)
+                written = write_lines(file, file_lines, info, info->dirty_line, total_lines);
+            if (fclose(file) != 0) written = -1;
+        }
+    }
+
+    if (written < 0) {
+        // Full rewrite through a temporary file so a failed save keeps the original
+        char tmp_path[MAX_PATH_LEN];
+        temp_path_for(filepath, tmp_path, sizeof(tmp_path));
+        FILE *file = fopen(tmp_path, "wb");
+        if (!file) return -1;
+
+        written = write_lines(file, file_lines, info, 0, total_lines);
+        if (fclose(file) != 0) written = -1;
+
+        // The old version becomes a backup, once per file opened
+        if (written >= 0 && !info->backed_up) info->backed_up = backup_move(filepath);
+        if (written < 0 || !commit_temp_file(tmp_path, filepath)) {
+            remove(tmp_path);
+            return -1;
+        }
+    }
+
+    info->disk_size = new_size;
+    info->disk_mtime = file_mtime(filepath);
+    info->dirty_line = total_lines;
+    return written;
+}
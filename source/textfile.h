@@ -0,0 +1,70 @@
+#ifndef TEXTFILE_H
+#define TEXTFILE_H
+
+#include <stdio.h>
+#include <time.h>
+#include "confedit.h"
+
+#define TEXT_BLOCK_SIZE   (16 * 1024)   // Bytes read from the card at once
+
+// Line endings, kept per line so files are written back exactly as read
+enum {
+    EOL_NONE,     // No ending: last line, or a long line continued on the next one
+    EOL_LF,
+    EOL_CRLF,
+    EOL_CR
+};
+
+extern const char *const eol_bytes[];
+
+// What is known about the file on disk, for saving
+typedef struct {
+    int dirty_line;               // First line that may differ from the disk
+    u32 disk_size;                // Size of the file on disk in bytes
+    time_t disk_mtime;            // Modification time of the file on disk
+    bool bom;                     // Starts with a UTF-8 byte order mark
+    bool utf8;                    // Contains valid UTF-8 multibyte sequences
+    bool binary;                  // Contains NUL bytes, can't be saved
+    bool truncated;               // Longer than MAX_LINES, can't be saved
+    bool backed_up;               // A backup was made since the file was read
+    u8 eol;                       // Ending used for new lines
+    u8 line_eol[MAX_LINES];       // Ending of each line
+} TextFileInfo;
+
+// Splits a file into lines of at most MAX_LINE_LENGTH - 1 bytes
+typedef struct {
+    FILE *file;
+    int start, end;               // Unread data in buf[start..end)
+    bool eof;
+    bool bom;
+    bool utf8;
+    bool binary;
+    u32 eol_count[4];             // Lines seen per ending
+    u8 buf[TEXT_BLOCK_SIZE];
+} TextReader;
+
+bool text_reader_open(TextReader *r, const char *filepath);
+void text_reader_close(TextReader *r);
+
+// Next line without its ending. Returns the EOL_* ending or -1 at end of file.
+int text_reader_next(TextReader *r, const u8 **line, int *len);
+
+// Load a file, returns the number of lines or -1 if it can't be opened
+int load_text_file(const char *filepath, char file_lines[][MAX_LINE_LENGTH], TextFileInfo *info);
+
+// The file on the card is no longer the one info was read from or saved
+// as: its size or modification time differ, e.g. a patch rewrote it
+bool text_file_changed(const char *filepath, const TextFileInfo *info);
+
+// Save the buffer, returns the number of bytes written or -1 on error
+int save_file(const char *filepath, char file_lines[][MAX_LINE_LENGTH], int total_lines, TextFileInfo *info);
+
+// Length of the valid UTF-8 sequence at p, 0 if invalid or longer than avail
+int utf8_sequence(const u8 *p, int avail);
+
+// True if the byte continues a UTF-8 sequence
+static inline bool utf8_continuation(char c) {
+    return ((u8)c & 0xC0) == 0x80;
+}
+
+#endif // TEXTFILE_H
@@ -0,0 +1,126 @@
+#include <nds.h>
+#include <stdio.h>
+#include <string.h>
+#include "confedit.h"
+#include "input.h"
+#include "ui.h"
+
+u32 ui_wait_key(u32 mask) {
+    while (1) {
+        u32 keys = input_keys_down() & mask;
+        if (keys) return keys;
+        swiWaitForVBlank();
+    }
+}
+
+void ui_message(const char *message) {
+    consoleClear();
+    iprintf("%s\nPress B to return.", message);
+    ui_wait_key(KEY_B);
+    consoleClear();
+}
+
+bool ui_prompt(const char *title, char *buffer, int size) {
+    int len = strlen(buffer);
+    bool accepted = false;
+
+    bool done = false;
+
+    input_flush();
+    input_keyboard(true);
+
+    while (!done) {
+        consoleClear();
+        iprintf("\x1b[1;1H%s", title);
+        iprintf("\x1b[3;1H> %s_", buffer);
+        iprintf("\x1b[5;1HEnter: OK  B: cancel");
+
+        InputEvent event;
+        while (!done && input_next(&event)) {
+            input_handled(&event);
+            int key = (event.type == INPUT_CHAR) ? event.code : 0;
+
+            if (key == 8) { // Backspace
+                if (len > 0) buffer[--len] = '\0';
+            } else if (key == 13 || key == 10) { // Enter
+                accepted = true;
+                done = true;
+            } else if (key >= 32 && key <= 126 && len < size - 1) {
+                buffer[len++] = (char)key;
+                buffer[len] = '\0';
+            } else if (event.type == INPUT_KEY_DOWN && event.code == KEY_B) {
+                done = true;
+            }
+        }
+
+        swiWaitForVBlank();
+    }
+
+    input_keyboard(false);
+    consoleClear();
+    return accepted;
+}
+
+int ui_menu(const char *title, const char *const items[], int count) {
+    int cursor = 0, scroll = 0;
+
+    while (1) {
+        consoleClear();
+        iprintf("\x1b[1;1H%s", title);
+
+        for (int i = scroll; i < count && i < scroll + MAX_VISIBLE_LINES; i++) {
+            iprintf("\x1b[%d;1H%s%s", i - scroll + TOP_MARGIN + 1, (i == cursor) ? "> " : "  ", items[i]);
+        }
+
+        u32 keys_down = input_keys_down();
+
+        if ((keys_down & KEY_UP) && cursor > 0) cursor--;
+        if ((keys_down & KEY_DOWN) && cursor < count - 1) cursor++;
+        if (keys_down & KEY_LEFT) cursor = (cursor > SKIP_LINES) ? cursor - SKIP_LINES : 0;
+        if (keys_down & KEY_RIGHT) cursor = (cursor + SKIP_LINES < count) ? cursor + SKIP_LINES : count - 1;
+        if (cursor < 0) cursor = 0;
+
+        if (cursor < scroll) scroll = cursor;
+        if (cursor >= scroll + MAX_VISIBLE_LINES) scroll = cursor - MAX_VISIBLE_LINES + 1;
+
+        if (keys_down & KEY_A) {
+            consoleClear();
+            return cursor;
+        }
+        if (keys_down & KEY_B) break;
+
+        swiWaitForVBlank();
+    }
+
+    consoleClear();
+    return -1;
+}
+
+u32 ui_view_lines(const char *title, const char *(*get_line)(int index), int count, u32 exit_keys) {
+    int scroll = 0;
+    int max_scroll = count - MAX_VISIBLE_LINES;
+    if (max_scroll < 0) max_scroll = 0;
+
+    while (1) {
+        consoleClear();
+        iprintf("\x1b[1;1H%s", title);
+
+        for (int i = 0; i < MAX_VISIBLE_LINES && scroll + i < count; i++) {
+            iprintf("\x1b[%d;1H%.32s", i + TOP_MARGIN + 1, get_line(scroll + i));
+        }
+
+        u32 keys_down = input_keys_down();
+        u32 keys_held = input_keys_held();
+
+        if ((keys_held & KEY_UP) && scroll > 0) scroll--;
+        if ((keys_held & KEY_DOWN) && scroll < max_scroll) scroll++;
+        if (keys_down & KEY_LEFT) scroll = (scroll > SKIP_LINES) ? scroll - SKIP_LINES : 0;
+        if (keys_down & KEY_RIGHT) scroll = (scroll + SKIP_LINES < max_scroll) ? scroll + SKIP_LINES : max_scroll;
+        if (keys_down & (exit_keys | KEY_B)) {
+            consoleClear();
+            return keys_down & (exit_keys | KEY_B);
+        }
+
+        swiWaitForVBlank();
+    }
+}
@@ -0,0 +1,22 @@
+#ifndef UI_H
+#define UI_H
+
+#include <nds.h>
+
+// Wait until one of the keys in mask is pressed, returns the pressed keys
+u32 ui_wait_key(u32 mask);
+
+// Show a message and wait for B
+void ui_message(const char *message);
+
+// Read a line of text with the touch keyboard. Returns false if cancelled with B
+bool ui_prompt(const char *title, char *buffer, int size);
+
+// Show a list of items and return the selected index, or -1 if cancelled with B
+int ui_menu(const char *title, const char *const items[], int count);
+
+// Scrollable read-only list of lines, returned by get_line(index).
+// Closed by B or any key in exit_keys, returns the key that closed it.
+u32 ui_view_lines(const char *title, const char *(*get_line)(int index), int count, u32 exit_keys);
+
+#endif // UI_H